@@ -23,7 +23,10 @@
 #include <iostream>
 #include <string.h>
 #include <stdio.h>
+#include <phiprof.hpp>
 #include "common.h"
+#include "parameters.h"
+#include "telemetry.h"
 
 /*! \brief A function to stop the simulation if the boolean condition is true.
  * Raises a flag which gets MPI_Reduced and initiates bailout.
@@ -86,6 +89,20 @@ void bailout(
    bailout(condition, message, "", 0);
 }
 
+/*! \brief Global MPI barrier, timed in the Barriers group so that load imbalance shows up
+ * in the profile. Only done if timed_barriers is set, otherwise processes synchronize
+ * only through the messages they exchange with their neighbors.
+ * \param name name of the barrier timer
+ */
+void addTimedBarrier(const std::string& name) {
+   if (!Parameters::timedBarriers) {
+      return;
+   }
+   phiprof::Timer btimer {name, {"Barriers", "MPI"}};
+   telemetry::PhaseTimer barrierPhase {telemetry::MPI_WAIT};
+   MPI_Barrier(MPI_COMM_WORLD);
+}
+
 /*! Helper function for error handling. err_type default to 0.*/
 [[ noreturn ]] void abort_mpi(const std::string str, const int err_type) {
    int myRank;
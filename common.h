@@ -56,6 +56,8 @@ void bailout(
 
 [[ noreturn ]] void abort_mpi(const std::string str, const int err_type = 0);
 
+void addTimedBarrier(const std::string& name);
+
 #define sqr(x) ((x)*(x))
 #define pow2(x) sqr(x)
 #define pow3(x) ((x)*(x)*(x))
@@ -3796,6 +3796,14 @@ bool DataReducer::hasParameters(const unsigned int& operatorID) const {
    return dynamic_cast<DRO::DataReductionOperatorHasParameters*>(operators[operatorID]) != nullptr;
 }
 
+/** Ask a DataReductionOperator if it is threaded internally.
+ * @param operatorID ID number of the DataReductionOperator.
+ * @return If true, the operator must not be called from within an OpenMP parallel region.*/
+bool DataReducer::isThreaded(const unsigned int& operatorID) const {
+   if (operatorID >= operators.size()) return false;
+   return operators[operatorID]->isThreaded();
+}
+
 /** Request a DataReductionOperator to calculate its output data and to write it to the given buffer.
  * @param cell Pointer to spatial cell whose data is to be reduced.
  * @param operatorID ID number of the applied DataReductionOperator.
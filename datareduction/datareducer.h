@@ -51,6 +51,7 @@ class DataReducer {
 
    std::string getName(const unsigned int& operatorID) const;
    bool hasParameters(const unsigned int& operatorID) const;
+   bool isThreaded(const unsigned int& operatorID) const;
    bool reduceData(const SpatialCell* cell,const unsigned int& operatorID,char* buffer);
    bool reduceDiagnostic(const SpatialCell* cell,const unsigned int& operatorID,Real * result);
    unsigned int size() const;
@@ -75,6 +75,8 @@ namespace DRO {
       virtual bool reduceData(const SpatialCell* cell,char* buffer);
       virtual bool reduceDiagnostic(const SpatialCell* cell,Real * result);
       virtual bool setSpatialCell(const SpatialCell* cell) = 0;
+      /** True if the reduction of one cell opens its own OpenMP parallel region. */
+      virtual bool isThreaded() const {return false;}
 
    protected:
       std::string unit;
@@ -393,6 +395,7 @@ namespace DRO {
       virtual bool reduceData(const SpatialCell* cell,char* buffer);
       virtual bool reduceDiagnostic(const SpatialCell* cell,Real *buffer);
       virtual bool setSpatialCell(const SpatialCell* cell);
+      virtual bool isThreaded() const {return true;}
 
    protected:
       Real maxF;
@@ -410,6 +413,7 @@ namespace DRO {
       virtual bool reduceData(const SpatialCell* cell,char* buffer);
       virtual bool reduceDiagnostic(const SpatialCell* cell,Real *buffer);
       virtual bool setSpatialCell(const SpatialCell* cell);
+      virtual bool isThreaded() const {return true;}
 
    protected:
       Real minF;
@@ -67,6 +67,16 @@ namespace geometry {
    };
 }
 
+/** Order of the 1D reconstructions used by the semi-Lagrangian Vlasov solvers.*/
+namespace reconstruction {
+   enum Order {
+      PLM,             /**< Piecewise linear, 2nd order.*/
+      PPM,             /**< Piecewise parabolic, 3rd order.*/
+      PQM,             /**< Piecewise quartic, 5th order.*/
+      ADAPTIVE         /**< PQM where the distribution is significant, PPM elsewhere.*/
+   };
+}
+
 namespace vmesh {
    #ifndef VAMR
    typedef uint32_t GlobalID;              /**< Datatype used for velocity block global IDs.*/
@@ -112,6 +122,9 @@ typedef Realf (*VAmrVelRefinement)(const Realf* velBlock);
 #define SHIFT_M_X_NEIGHBORHOOD_ID 17 //Shift in -x direction
 #define SHIFT_M_Y_NEIGHBORHOOD_ID 18 //Shift in -y direction
 #define SHIFT_M_Z_NEIGHBORHOOD_ID 19 //Shift in -z direction
+#define VLASOV_SOLVER_GHOST_X_NEIGHBORHOOD_ID 20 //same as VLASOV_SOLVER_X, for ghost transfers overlapping AMR remote updates
+#define VLASOV_SOLVER_GHOST_Y_NEIGHBORHOOD_ID 21 //same as VLASOV_SOLVER_Y, for ghost transfers overlapping AMR remote updates
+#define VLASOV_SOLVER_GHOST_Z_NEIGHBORHOOD_ID 22 //same as VLASOV_SOLVER_Z, for ghost transfers overlapping AMR remote updates
 
 //fieldsolver stencil.
 #define FS_STENCIL_WIDTH 2
@@ -27,6 +27,8 @@
 #include <vector>
 #include <sstream>
 #include <ctime>
+#include <algorithm>
+#include <utility>
 #ifdef _OPENMP
   #include <omp.h>
 #endif
@@ -484,7 +486,8 @@ void setFaceNeighborRanks( dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
    }
 }
 
-void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, SysBoundary& sysBoundaries){
+void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, SysBoundary& sysBoundaries,
+                 const std::unordered_map<CellID,Real>& weightFactors){
    // Invalidate cached cell lists
    Parameters::meshRepartitioned = true;
 
@@ -503,7 +506,12 @@ void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, S
       //counter which is updated in acceleration, otherwise we just
       //use the number of blocks.
 //      if (P::propagateVlasovAcceleration) 
-      mpiGrid.set_cell_weight(cells[i], mpiGrid[cells[i]]->parameters[CellParams::LBWEIGHTCOUNTER]);
+      Real weight = mpiGrid[cells[i]]->parameters[CellParams::LBWEIGHTCOUNTER];
+      const auto factor = weightFactors.find(cells[i]);
+      if (factor != weightFactors.end()) {
+         weight *= factor->second;
+      }
+      mpiGrid.set_cell_weight(cells[i], weight);
 //      else
 //         mpiGrid.set_cell_weight(cells[i], mpiGrid[cells[i]]->get_number_of_all_velocity_blocks());
       //reset counter
@@ -556,25 +564,20 @@ void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, S
          SpatialCell::set_mpi_transfer_type(Transfer::VEL_BLOCK_LIST_STAGE2);
          mpiGrid.continue_balance_load();
 
-         int prepareReceives {phiprof::initializeTimer("Preparing receives")};
+         // reserve space for velocity block data in arriving remote cells. This
+         // is done by all threads so that the block data is first touched, and
+         // thus placed in memory, on all NUMA domains of the process.
+         phiprof::Timer prepareReceivesTimer {"Preparing receives"};
          int receives = 0;
+         #pragma omp parallel for schedule(static) reduction(+:receives)
          for (unsigned int i=0; i<incoming_cells_list.size(); i++) {
             CellID cell_id=incoming_cells_list[i];
-            SpatialCell* cell = mpiGrid[cell_id];
             if (cell_id % num_part_transfers == transfer_part) {
                receives++;
-               // reserve space for velocity block data in arriving remote cells
-               phiprof::Timer timer {prepareReceives};
-               cell->prepare_to_receive_blocks(p);
-               timer.stop(1, "Spatial cells");
+               mpiGrid[cell_id]->prepare_to_receive_blocks(p);
             }
          }
-         if(receives == 0) {
-            //empty phiprof timer, to avoid unneccessary divergence in unique
-            //profiles (keep order same)
-            phiprof::Timer timer {prepareReceives};
-            timer.stop(0, "Spatial cells");
-         }
+         prepareReceivesTimer.stop(receives, "Spatial cells");
 
          //do the actual transfer of data for the set of cells to be transferred
          phiprof::Timer transferTimer {"transfer_all_data"};
@@ -1086,6 +1089,10 @@ void initializeStencils(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpi
       std::cerr << "Failed to add neighborhood VLASOV_SOLVER_X_NEIGHBORHOOD_ID \n";
       abort();
    }
+   if (P::amrMaxSpatialRefLevel > 0 && !mpiGrid.add_neighborhood(VLASOV_SOLVER_GHOST_X_NEIGHBORHOOD_ID, neighborhood)){
+      std::cerr << "Failed to add neighborhood VLASOV_SOLVER_GHOST_X_NEIGHBORHOOD_ID \n";
+      abort();
+   }
 
 
    neighborhood.clear();
@@ -1098,6 +1105,10 @@ void initializeStencils(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpi
       std::cerr << "Failed to add neighborhood VLASOV_SOLVER_Y_NEIGHBORHOOD_ID \n";
       abort();
    }
+   if (P::amrMaxSpatialRefLevel > 0 && !mpiGrid.add_neighborhood(VLASOV_SOLVER_GHOST_Y_NEIGHBORHOOD_ID, neighborhood)){
+      std::cerr << "Failed to add neighborhood VLASOV_SOLVER_GHOST_Y_NEIGHBORHOOD_ID \n";
+      abort();
+   }
 
    
    neighborhood.clear();
@@ -1110,6 +1121,10 @@ void initializeStencils(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpi
       std::cerr << "Failed to add neighborhood VLASOV_SOLVER_Z_NEIGHBORHOOD_ID \n";
       abort();
    }
+   if (P::amrMaxSpatialRefLevel > 0 && !mpiGrid.add_neighborhood(VLASOV_SOLVER_GHOST_Z_NEIGHBORHOOD_ID, neighborhood)){
+      std::cerr << "Failed to add neighborhood VLASOV_SOLVER_GHOST_Z_NEIGHBORHOOD_ID \n";
+      abort();
+   }
 
    neighborhood.clear();
    for (int d = -1; d <= 1; d++) {
@@ -1390,6 +1405,32 @@ void mapRefinement(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
    }
 }
 
+void balanceLoadForRefinement(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, SysBoundary& sysBoundaries, Project& project) {
+   phiprof::Timer balanceTimer {"Balance load for refinement"};
+
+   // Same refinement decision as in adaptRefinement
+   if (P::tstep != P::tstep_min) {
+      calculateScaledDeltasSimple(mpiGrid);
+   }
+   SpatialCell::set_mpi_transfer_type(Transfer::REFINEMENT_PARAMETERS);
+   mpiGrid.update_copies_of_remote_neighbors(NEAREST_NEIGHBORHOOD_ID);
+   project.adaptRefinement(mpiGrid);
+   mpiGrid.initialize_refines();
+
+   // Each child starts as a copy of its parent, and unrefined siblings are averaged into one parent.
+   // Only the weights given to dccrg are scaled, the accumulated LBWEIGHTCOUNTERs stay as they are.
+   std::unordered_map<CellID,Real> weightFactors;
+   for (CellID id : mpiGrid.get_local_cells_to_refine()) {
+      weightFactors[id] = 8.0;
+   }
+   for (CellID id : mpiGrid.get_local_cells_to_unrefine()) {
+      weightFactors[id] = 1.0 / 8.0;
+   }
+   mpiGrid.cancel_refining();
+
+   balanceLoad(mpiGrid, sysBoundaries, weightFactors);
+}
+
 bool adaptRefinement(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, FsGrid<fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid, SysBoundary& sysBoundaries, Project& project, int useStatic) {
    phiprof::Timer amrTimer {"Re-refine spatial cells"};
    int refines {0};
@@ -1478,20 +1519,14 @@ bool adaptRefinement(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGri
       SpatialCell::set_mpi_transfer_type(Transfer::VEL_BLOCK_LIST_STAGE2);
       mpiGrid.continue_refining();
    
-      int prepareReceives {phiprof::initializeTimer("Preparing receives")};
-      for (CellID id : receives) {
-         // reserve space for velocity block data in arriving remote cells
-         phiprof::Timer timer {prepareReceives};
-         mpiGrid[id]->prepare_to_receive_blocks(p);
-         timer.stop(1, "Spatial cells");
-      }
-
-      if(receives.empty()) {
-         //empty phiprof timer, to avoid unneccessary divergence in unique
-         //profiles (keep order same)
-         phiprof::Timer timer {prepareReceives};
-         timer.stop(0, "Spatial cells");
+      // reserve space for velocity block data in arriving remote cells, first
+      // touched by all threads as in balanceLoad
+      phiprof::Timer prepareReceivesTimer {"Preparing receives"};
+      #pragma omp parallel for schedule(static)
+      for (size_t i = 0; i < receives.size(); ++i) {
+         mpiGrid[receives[i]]->prepare_to_receive_blocks(p);
       }
+      prepareReceivesTimer.stop(receives.size(), "Spatial cells");
       
       //do the actual transfer of data for the set of cells to be transferred
       phiprof::Timer transferTimer {"transfer_all_data"};
@@ -1502,34 +1537,66 @@ bool adaptRefinement(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGri
    transfersTimer.stop();
 
    phiprof::Timer copyChildrenTimer {"copy to children"};
+   // Group the new children by parent. The refined parents are dropped in
+   // finish_refining, so the last child of each parent takes over its
+   // velocity space instead of copying it.
+   std::vector<std::pair<CellID,CellID>> parentsAndChildren;
+   parentsAndChildren.reserve(newChildren.size());
    for (CellID id : newChildren) {
-      *mpiGrid[id] = *mpiGrid[mpiGrid.get_parent(id)];
-      // Irrelevant?
-      // mpiGrid[id]->parameters[CellParams::AMR_ALPHA] /= P::refineMultiplier;
-      mpiGrid[id]->parameters[CellParams::AMR_ALPHA] /= 2.0;
-      mpiGrid[id]->parameters[CellParams::RECENTLY_REFINED] = 1;
+      parentsAndChildren.push_back(std::make_pair(mpiGrid.get_parent(id), id));
+   }
+   std::sort(parentsAndChildren.begin(), parentsAndChildren.end());
+   std::vector<size_t> parentOffsets;
+   for (size_t i = 0; i < parentsAndChildren.size(); ++i) {
+      if (i == 0 || parentsAndChildren[i].first != parentsAndChildren[i-1].first) {
+         parentOffsets.push_back(i);
+      }
+   }
+   parentOffsets.push_back(parentsAndChildren.size());
+
+   #pragma omp parallel for schedule(dynamic)
+   for (size_t p = 0; p < parentOffsets.size() - 1; ++p) {
+      SpatialCell* parentCell = mpiGrid[parentsAndChildren[parentOffsets[p]].first];
+      for (size_t i = parentOffsets[p]; i < parentOffsets[p+1]; ++i) {
+         SpatialCell* childCell = mpiGrid[parentsAndChildren[i].second];
+         if (i + 1 < parentOffsets[p+1]) {
+            *childCell = *parentCell;
+         } else {
+            *childCell = std::move(*parentCell);
+         }
+         // Irrelevant?
+         // childCell->parameters[CellParams::AMR_ALPHA] /= P::refineMultiplier;
+         childCell->parameters[CellParams::AMR_ALPHA] /= 2.0;
+         childCell->parameters[CellParams::RECENTLY_REFINED] = 1;
+      }
    }
    copyChildrenTimer.stop(newChildren.size(), "Spatial cells");
 
    // Old cells removed by refinement
    phiprof::Timer copyParentsTimer {"copy to parents"};
    std::set<CellID> processed;
+   std::vector<std::pair<CellID,CellID>> parentsAndFirstChild;
    for (CellID id : mpiGrid.get_removed_cells()) {
       CellID parent = mpiGrid.get_existing_cell(mpiGrid.get_center(id));
       if (!processed.count(parent)) {
-         std::vector<CellID> children = mpiGrid.get_all_children(parent);
-         // Make sure cell contents aren't garbage
-         *mpiGrid[parent] = *mpiGrid[id];
-
-         for (uint popID=0; popID<getObjectWrapper().particleSpecies.size(); ++popID) {
-            SBC::averageCellData(mpiGrid, children, mpiGrid[parent], popID, 1);
-         }
+         parentsAndFirstChild.push_back(std::make_pair(parent, id));
+         processed.insert(parent);
+      }
+   }
 
-         // Averaging moments
-         calculateCellMoments(mpiGrid[parent], true, false);
+   #pragma omp parallel for schedule(dynamic)
+   for (size_t p = 0; p < parentsAndFirstChild.size(); ++p) {
+      const CellID parent = parentsAndFirstChild[p].first;
+      std::vector<CellID> children = mpiGrid.get_all_children(parent);
+      // Make sure cell contents aren't garbage
+      *mpiGrid[parent] = *mpiGrid[parentsAndFirstChild[p].second];
 
-         processed.insert(parent);
+      for (uint popID=0; popID<getObjectWrapper().particleSpecies.size(); ++popID) {
+         SBC::averageCellData(mpiGrid, children, mpiGrid[parent], popID, 1);
       }
+
+      // Averaging moments
+      calculateCellMoments(mpiGrid[parent], true, false);
    }
    copyParentsTimer.stop(processed.size(), "Spatial cells");
 
@@ -29,6 +29,7 @@
 #include "sysboundary/sysboundary.h"
 #include "projects/project.h"
 #include <string>
+#include <unordered_map>
 
 /*!
   \brief Initialize DCCRG and fsgrids
@@ -53,8 +54,10 @@ void initializeGrids(
   \brief Balance load
 
     \param[in,out] mpiGrid The DCCRG grid with spatial cells
+    \param[in] weightFactors Optional factors applied to the LBWEIGHTCOUNTER of given cells when setting their weights
 */
-void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, SysBoundary& sysBoundaries);
+void balanceLoad(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, SysBoundary& sysBoundaries,
+                 const std::unordered_map<CellID,Real>& weightFactors = {});
 
 /*!
 
@@ -120,6 +123,17 @@ void setFaceNeighborRanks( dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
  */
 void mapRefinement(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, FsGrid<fsgrids::technical, FS_STENCIL_WIDTH> & technicalGrid);
 
+/*! Balance the load for the grid that a following adaptRefinement call will produce.
+ * The load balance weights of the cells adaptRefinement would refine are multiplied
+ * by the number of children they will have, and those of cells it would unrefine 
+ * divided by it, so that only the coarse parent cells migrate and their children
+ * are created directly on the final process. The LBWEIGHTCOUNTERs themselves are left unchanged.
+ * \param mpiGrid Spatial grid
+ * \param sysBoundaries System boundaries
+ * \param project Project used
+ */
+void balanceLoadForRefinement(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid, SysBoundary& sysBoundaries, Project& project);
+
 /*! Refine spatial cells and update necessary information
  * \param mpiGrid Spatial grid
  * \param technicalGrid Technical grid
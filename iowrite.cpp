@@ -1858,10 +1858,83 @@ bool writeRestart(
 }
 
 
+/*! Diagnostic data of one step whose reduction to the master rank is in flight.
+ *  The data is laid out as nOps minima, nOps maxima, and the cell count followed by nOps sums.
+ */
+static struct {
+   MPI_Request request {MPI_REQUEST_NULL};
+   vector<Real> localData;
+   vector<Real> globalData;
+   uint nOps {0};
+   uint tstep {0};
+   Real t {0.0};
+   Real dt {0.0};
+} pendingDiagnostic;
+
+static MPI_Datatype diagnosticDatatype {MPI_DATATYPE_NULL};
+static MPI_Op diagnosticOp {MPI_OP_NULL};
+
+/*! MPI reduction operator computing the minima, maxima and sums of diagnostic data in one pass.
+ *  The number of operators is recovered from the size of the contiguous datatype.
+ */
+static void reduceDiagnosticData(void* in, void* inout, int* len, MPI_Datatype* datatype) {
+   int typeSize;
+   MPI_Type_size(*datatype, &typeSize);
+   const size_t nValues = typeSize / sizeof(Real);
+   const size_t nOps = (nValues - 1) / 3;
+   for (int n=0; n<*len; ++n) {
+      const Real* a = reinterpret_cast<const Real*>(in) + n*nValues;
+      Real* b = reinterpret_cast<Real*>(inout) + n*nValues;
+      for (size_t i=0; i<nOps; ++i) {
+         b[i] = min(a[i], b[i]);
+         b[nOps+i] = max(a[nOps+i], b[nOps+i]);
+      }
+      for (size_t i=2*nOps; i<nValues; ++i) {
+         b[i] += a[i];
+      }
+   }
+}
+
+/*! Wait for the pending diagnostic reduction, if any, and write its row into diagnostic.txt on the master rank.
+ */
+static void completePendingDiagnostic() {
+   if (pendingDiagnostic.request == MPI_REQUEST_NULL) return;
+   MPI_Wait(&pendingDiagnostic.request, MPI_STATUS_IGNORE);
+
+   int myRank;
+   MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
+   if (myRank != MASTER_RANK) return;
+
+   const uint nOps = pendingDiagnostic.nOps;
+   const Real* globalMin = &pendingDiagnostic.globalData[0];
+   const Real* globalMax = &pendingDiagnostic.globalData[nOps];
+   const Real* globalSum = &pendingDiagnostic.globalData[2*nOps];
+
+   diagnostic << setprecision(12); 
+   diagnostic << pendingDiagnostic.tstep << "\t";
+   diagnostic << pendingDiagnostic.t << "\t";
+   diagnostic << pendingDiagnostic.dt << "\t";
+   
+   for (uint i=0; i<nOps; ++i) {
+      Real globalAvg;
+      if (globalSum[0] != 0.0) globalAvg = globalSum[i+1] / globalSum[0];
+      else globalAvg = globalSum[i+1];
+      diagnostic << globalMin[i] << "\t" <<
+      globalMax[i] << "\t" <<
+      globalSum[i+1] << "\t" <<
+      globalAvg << "\t";
+   }
+   diagnostic << endl << write;
+}
+
 /*!
 
 \brief Write out simulation diagnostics into diagnostic.txt
 
+The local data is reduced in parallel over the data reduction operators, and the
+global reduction is started nonblocking. The row of this step is written when the
+reduction is completed by the next call, or by finalizeDiagnostic.
+
 \param mpiGrid   The DCCRG grid with spatial cells
 \param dataReducer Contains datareductionoperators that are used to compute diagnostic data
 */
@@ -1880,11 +1953,9 @@ bool writeDiagnostic(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
    // Exit if the user does not want any diagnostics output
    if (nOps == 0) return true;
 
-   vector<Real> localMin(nOps), localMax(nOps), localSum(nOps+1), localAvg(nOps),
-               globalMin(nOps),globalMax(nOps),globalSum(nOps+1),globalAvg(nOps);
-   localSum[0] = 1.0 * nCells;
-   Real buffer;
-   bool success = true;
+   // Write out the previous step, its reduction has had the time in between to progress
+   completePendingDiagnostic();
+
    static bool printDiagnosticHeader = true;
    
    if (printDiagnosticHeader == true && myRank == MASTER_RANK) {
@@ -1899,51 +1970,88 @@ bool writeDiagnostic(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
       }
       printDiagnosticHeader = false;
    }
+
+   if (diagnosticOp == MPI_OP_NULL) {
+      MPI_Op_create(&reduceDiagnosticData, true, &diagnosticOp);
+   }
+   if (pendingDiagnostic.nOps != nOps) {
+      if (diagnosticDatatype != MPI_DATATYPE_NULL) MPI_Type_free(&diagnosticDatatype);
+      MPI_Type_contiguous(3*nOps + 1, MPI_Type<Real>(), &diagnosticDatatype);
+      MPI_Type_commit(&diagnosticDatatype);
+      pendingDiagnostic.nOps = nOps;
+      pendingDiagnostic.localData.resize(3*nOps + 1);
+      pendingDiagnostic.globalData.resize(3*nOps + 1);
+   }
+   Real* localMin = &pendingDiagnostic.localData[0];
+   Real* localMax = &pendingDiagnostic.localData[nOps];
+   Real* localSum = &pendingDiagnostic.localData[2*nOps];
+   localSum[0] = 1.0 * nCells;
    
    for (uint i=0; i<nOps; ++i) {
-      
       if (dataReducer.getDataVectorInfo(i,dataType,dataSize,vectorSize) == false) {
          cerr << "ERROR when requesting info from diagnostic DRO " << dataReducer.getName(i) << endl;
       }
-      localMin[i] = std::numeric_limits<Real>::max();
-      localMax[i] = std::numeric_limits<Real>::min();
-      localSum[i+1] = 0.0;
-      buffer = 0.0;
+   }
+
+   // The operators keep the current cell as state, so each one is handled by a single thread.
+   // Operators that are threaded within are run afterwards, outside of the parallel region.
+   vector<char> opSuccess(nOps, true);
+   vector<uint> serialOps, threadedOps;
+   for (uint i=0; i<nOps; ++i) {
+      if (dataReducer.isThreaded(i)) threadedOps.push_back(i);
+      else serialOps.push_back(i);
+   }
+   auto reduceOperator = [&](const uint i) {
+      Real opMin = std::numeric_limits<Real>::max();
+      Real opMax = std::numeric_limits<Real>::min();
+      Real opSum = 0.0;
+      Real buffer = 0.0;
+      bool success = true;
       
       // Request DataReductionOperator to calculate the reduced data for all local cells:
       for (uint64_t cell=0; cell<nCells; ++cell) {
          success = true;
          if (dataReducer.reduceDiagnostic(mpiGrid[cells[cell]], i, &buffer) == false) success = false;
-         localMin[i] = min(buffer, localMin[i]);
-         localMax[i] = max(buffer, localMax[i]);
-         localSum[i+1] += buffer;
+         opMin = min(buffer, opMin);
+         opMax = max(buffer, opMax);
+         opSum += buffer;
       }
-      localAvg[i] = localSum[i+1];
-      
-      if (success == false) logFile << "(MAIN) writeDiagnostic: ERROR datareductionoperator '" << dataReducer.getName(i) <<
-                               "' returned false!" << endl << writeVerbose;
+      localMin[i] = opMin;
+      localMax[i] = opMax;
+      localSum[i+1] = opSum;
+      opSuccess[i] = success;
+   };
+   #pragma omp parallel for schedule(dynamic,1)
+   for (uint n=0; n<serialOps.size(); ++n) {
+      reduceOperator(serialOps[n]);
    }
-   
-   MPI_Reduce(&localMin[0], &globalMin[0], nOps, MPI_Type<Real>(), MPI_MIN, 0, MPI_COMM_WORLD);
-   MPI_Reduce(&localMax[0], &globalMax[0], nOps, MPI_Type<Real>(), MPI_MAX, 0, MPI_COMM_WORLD);
-   MPI_Reduce(&localSum[0], &globalSum[0], nOps + 1, MPI_Type<Real>(), MPI_SUM, 0, MPI_COMM_WORLD);
-   
-   diagnostic << setprecision(12); 
-   diagnostic << Parameters::tstep << "\t";
-   diagnostic << Parameters::t << "\t";
-   diagnostic << Parameters::dt << "\t";
-   
+   for (uint n=0; n<threadedOps.size(); ++n) {
+      reduceOperator(threadedOps[n]);
+   }
+
    for (uint i=0; i<nOps; ++i) {
-      if (globalSum[0] != 0.0) globalAvg[i] = globalSum[i+1] / globalSum[0];
-      else globalAvg[i] = globalSum[i+1];
-      if (myRank == MASTER_RANK) {
-         diagnostic << globalMin[i] << "\t" <<
-         globalMax[i] << "\t" <<
-         globalSum[i+1] << "\t" <<
-         globalAvg[i] << "\t";
-      }
+      if (!opSuccess[i]) logFile << "(MAIN) writeDiagnostic: ERROR datareductionoperator '" << dataReducer.getName(i) <<
+                            "' returned false!" << endl << writeVerbose;
    }
-   if (myRank == MASTER_RANK) diagnostic << endl << write;
+
+   pendingDiagnostic.tstep = Parameters::tstep;
+   pendingDiagnostic.t = Parameters::t;
+   pendingDiagnostic.dt = Parameters::dt;
+   MPI_Ireduce(pendingDiagnostic.localData.data(), pendingDiagnostic.globalData.data(), 1, diagnosticDatatype, diagnosticOp,
+               MASTER_RANK, MPI_COMM_WORLD, &pendingDiagnostic.request);
    return true;
 }
 
+/*!
+
+\brief Complete the last nonblocking diagnostic reduction and write its row into diagnostic.txt
+
+Collective on MPI_COMM_WORLD, to be called before closing the diagnostic file.
+*/
+void finalizeDiagnostic() {
+   completePendingDiagnostic();
+   if (diagnosticDatatype != MPI_DATATYPE_NULL) MPI_Type_free(&diagnosticDatatype);
+   if (diagnosticOp != MPI_OP_NULL) MPI_Op_free(&diagnosticOp);
+   pendingDiagnostic.nOps = 0;
+}
+
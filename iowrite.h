@@ -99,6 +99,14 @@ bool writeRestart(
 */
 bool writeDiagnostic(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,DataReducer& dataReducer);
 
+/*!
+
+\brief Complete the last nonblocking diagnostic reduction and write its row into diagnostic.txt
+
+Collective on MPI_COMM_WORLD, to be called before closing the diagnostic file.
+*/
+void finalizeDiagnostic();
+
 bool writeVelocitySpace(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
                         vlsv::Writer& vlsvWriter,int index,const std::vector<uint64_t>& cells);
 
@@ -25,6 +25,17 @@
 #include <math.h>
 #include <unordered_map> // for hasher
 #include <limits>
+#include <algorithm>
+#include <set>
+#include <fstream>
+#include <sstream>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "logger.h"
 #include "memoryallocation.h"
 #include "common.h"
@@ -110,6 +121,52 @@ uint64_t get_node_free_memory(){
    return mem_proc_free;
 }
 
+/*! Resident memory of this process on the NUMA nodes its OpenMP threads run on
+ *  (local) and on the other nodes (remote), in bytes, read from /proc/self/numa_maps.
+ *  Assumes the threads are pinned, e.g. with OMP_PROC_BIND.
+ */
+static void get_numa_resident_bytes(double& localBytes, double& remoteBytes) {
+   localBytes = 0.0;
+   remoteBytes = 0.0;
+#ifdef __linux__
+   std::set<unsigned int> localNodes;
+   #pragma omp parallel
+   {
+      unsigned int cpu, node;
+      if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+         #pragma omp critical
+         localNodes.insert(node);
+      }
+   }
+
+   std::ifstream numaMaps("/proc/self/numa_maps");
+   std::string line;
+   while (std::getline(numaMaps, line)) {
+      // Each mapping lists its page counts per node as N<node>=<pages>
+      std::istringstream tokens(line);
+      std::string token;
+      double pageKiB = 4.0;
+      std::vector<std::pair<unsigned int,double>> nodePages;
+      while (tokens >> token) {
+         unsigned int node;
+         double pages, kiB;
+         if (sscanf(token.c_str(), "N%u=%lf", &node, &pages) == 2) {
+            nodePages.push_back(std::make_pair(node, pages));
+         } else if (sscanf(token.c_str(), "kernelpagesize_kB=%lf", &kiB) == 1) {
+            pageKiB = kiB;
+         }
+      }
+      for (const auto& np : nodePages) {
+         if (localNodes.count(np.first)) {
+            localBytes += np.second * pageKiB * 1024;
+         } else {
+            remoteBytes += np.second * pageKiB * 1024;
+         }
+      }
+   }
+#endif
+}
+
 /*! Measures memory consumption and writes it into logfile. 
  *  Collective operation on MPI_COMM_WORLD
  *  extra_bytes is used for additional buffer for the high water mark, 
@@ -201,6 +258,20 @@ void report_process_memory_consumption(double extra_bytes){
    logFile << writeVerbose;
    */
 
+   if (Parameters::reportNumaLocality) {
+      double numaBytes[2];
+      double sumNumaBytes[2];
+      get_numa_resident_bytes(numaBytes[0], numaBytes[1]);
+      double remoteFraction = numaBytes[1] / std::max(numaBytes[0] + numaBytes[1], 1.0);
+      double maxRemoteFraction;
+      MPI_Reduce(numaBytes, sumNumaBytes, 2, MPI_DOUBLE, MPI_SUM, MASTER_RANK, MPI_COMM_WORLD);
+      MPI_Reduce(&remoteFraction, &maxRemoteFraction, 1, MPI_DOUBLE, MPI_MAX, MASTER_RANK, MPI_COMM_WORLD);
+      if (rank == MASTER_RANK) {
+         logFile << "(MEM) tstep " << Parameters::tstep << " t " << Parameters::t << " Resident on local / remote NUMA nodes (GiB) sum: " << sumNumaBytes[0]/GiB << " / " << sumNumaBytes[1]/GiB <<
+            " max remote fraction per process: " << maxRemoteFraction << endl;
+      }
+   }
+
    MPI_Comm_free(&interComm);
    MPI_Comm_free(&nodeComm);
 
@@ -32,6 +32,12 @@
 #include "jemalloc/jemalloc.h"
 #endif
 
+#ifdef USE_TRANSPARENT_HUGEPAGES
+#include <sys/mman.h>
+/*! Allocations at least this large are backed by transparent huge pages */
+#define HUGEPAGE_MIN_BYTES (2*1024*1024)
+#endif
+
 #ifndef NDEBUG
 #ifndef INITIALIZE_ALIGNED_MALLOC_WITH_NAN
 #define INITIALIZE_ALIGNED_MALLOC_WITH_NAN
@@ -68,6 +74,20 @@ inline void * aligned_malloc(size_t size,std::size_t align) {
 #else
    void *p = malloc(size + align - 1 + sizeof(void*));
 #endif
+#ifdef USE_TRANSPARENT_HUGEPAGES
+   /* Large areas such as velocity block data are advised to use huge pages
+    * before they are first touched. madvise needs page aligned limits, so the
+    * pages only partially in the area are left out.
+    */
+   if (p != NULL && size >= HUGEPAGE_MIN_BYTES) {
+      const unsigned long pageSize = 4096;
+      const unsigned long begin = ((unsigned long)p + pageSize - 1) & ~(pageSize - 1);
+      const unsigned long end = ((unsigned long)p + size + align - 1 + sizeof(void*)) & ~(pageSize - 1);
+      if (end > begin) {
+         madvise((void*)begin, end - begin, MADV_HUGEPAGE);
+      }
+   }
+#endif
 #ifdef INITIALIZE_ALIGNED_MALLOC_WITH_NAN
    memset(p, ~0u, size + align - 1 + sizeof(void*));
 #endif
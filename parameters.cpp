@@ -75,6 +75,8 @@ uint P::tstep = 0;
 uint P::tstep_min = 0;
 uint P::tstep_max = 0;
 uint P::diagnosticInterval = numeric_limits<uint>::max();
+uint P::telemetryInterval = 0;
+string P::telemetryFileName = string("telemetry.csv");
 bool P::writeInitialState = true;
 bool P::writeFullBGB = false;
 
@@ -114,6 +116,8 @@ bool P::propagateVlasovTranslation = true;
 bool P::propagateField = true;
 
 bool P::dynamicTimestep = true;
+bool P::timedBarriers = false;
+bool P::reportNumaLocality = false;
 
 Real P::maxWaveVelocity = 0.0;
 uint P::maxFieldSolverSubcycles = 0.0;
@@ -140,6 +144,14 @@ vector<string> P::diagnosticVariableList;
 string P::projectName = string("");
 
 bool P::vlasovAccelerateMaxwellianBoundaries = false;
+bool P::vlasovLocalAccelerationSubcycles = false;
+bool P::vlasovOnTheFlyMoments = false;
+uint P::vlasovThreadedAccelerationBlocks = 0;
+bool P::vlasovPackedGhostTransfers = false;
+bool P::vlasovIterativeAccelerationTransform = false;
+int P::vlasovAccelerationReconstruction = reconstruction::PQM;
+int P::vlasovTranslationReconstruction = reconstruction::PPM;
+Real P::vlasovAdaptiveReconstructionThreshold = 10.0;
 Real P::maxSlAccelerationRotation = 10.0;
 Real P::hallMinimumRhom = physicalconstants::MASS_PROTON;
 Real P::hallMinimumRhoq = physicalconstants::CHARGE;
@@ -174,6 +186,7 @@ Real P::alphaDBSqWeight = 1.0;
 Real P::alphaDBWeight = 1.0;
 
 uint P::refineCadence = 5;
+bool P::balanceBeforeRefine = false;
 Real P::refineAfter = 0.0;
 Real P::refineRadius = LARGE_REAL;
 int P::maxFilteringPasses = 0;
@@ -194,10 +207,28 @@ std::array<FsGridTools::Task_t,3> P::overrideReadFsGridDecomposition = {0,0,0};
 std::string tracerString; /*!< Fieldline tracer to use for coupling ionosphere and magnetosphere */
 bool P::computeCurvature;
 
+/*! Convert the name of a reconstruction in the config to reconstruction::Order, abort if unknown.*/
+static int parseReconstructionOrder(const string& name) {
+   if (name == "PLM") {
+      return reconstruction::PLM;
+   } else if (name == "PPM") {
+      return reconstruction::PPM;
+   } else if (name == "PQM") {
+      return reconstruction::PQM;
+   } else if (name == "adaptive") {
+      return reconstruction::ADAPTIVE;
+   }
+   cerr << "Unknown reconstruction " << name << " in " << __FILE__ << ":" << __LINE__ << endl;
+   MPI_Abort(MPI_COMM_WORLD, 1);
+   return reconstruction::PPM;
+}
+
 bool P::addParameters() {
    typedef Readparameters RP;
    // the other default parameters we read through the add/get interface
    RP::add("io.diagnostic_write_interval", "Write diagnostic output every arg time steps", numeric_limits<uint>::max());
+   RP::add("io.telemetry_interval", "Append per-step phase timings, MPI wait time, cell and block counts and memory high water mark (min, avg, max, rank of max over processes) into the telemetry file every arg time steps, 0 disables", (uint)0);
+   RP::add("io.telemetry_file_name", "Name of the CSV file the performance telemetry is appended to", string("telemetry.csv"));
 
    RP::addComposing(
        "io.system_write_t_interval",
@@ -271,6 +302,8 @@ bool P::addParameters() {
            "zero length timesteps.",
            true);
    RP::add("dynamic_timestep", "If true,  timestep is set based on  CFL limits (default on)", true);
+   RP::add("report_numa_locality", "If true, memory reports also give the resident memory on the NUMA nodes the threads of each process run on, and on other nodes (Linux, pinned threads, default off)", false);
+   RP::add("timed_barriers", "If true, insert timed global MPI barriers between solver phases to measure load imbalance (profiling/debugging, default off)", false);
    RP::add("hallMinimumRho",
            "Minimum rho value used for the Hall and electron pressure gradient terms in the Lorentz force and in the "
            "field solver. Default is very low and has no effect in practice.",
@@ -367,6 +400,54 @@ bool P::addParameters() {
    RP::add("vlasovsolver.accelerateMaxwellianBoundaries",
            "Propagate maxwellian boundary cell contents in velocity space. Default false.",
            false);
+   RP::add("vlasovsolver.localAccelerationSubcycles",
+           "Run all acceleration subcycles of a cell in one go, adjusting velocity blocks locally between subcycles "
+           "and with the spatial neighbours only after the last one. Avoids the global subcycle lockstep. Default false.",
+           false);
+   RP::add("vlasovsolver.onTheFlyMoments",
+           "Accumulate the _V moments needed between local acceleration subcycles while the last 1D mapping writes "
+           "back the distribution, instead of reading all blocks again. Only used with localAccelerationSubcycles. Default false.",
+           false);
+   RP::add("vlasovsolver.threadedAccelerationBlocks",
+           "Cells with at least this many velocity blocks of a population are accelerated one at a time, with their "
+           "block column sets shared between all threads. 0 disables this. Default 0.",
+           0);
+   RP::add("vlasovsolver.packedGhostTransfers",
+           "Pack the velocity block data of ghost cells in translation losslessly (zero values are left out) "
+           "before sending it. Costs an extra exchange of the packed sizes. Default false.",
+           false);
+   // The ACC_SEMILAG_ and TRANS_SEMILAG_ compile flags set the default reconstructions
+#if defined(ACC_SEMILAG_PLM)
+   const string accReconstructionDefault("PLM");
+#elif defined(ACC_SEMILAG_PPM)
+   const string accReconstructionDefault("PPM");
+#else
+   const string accReconstructionDefault("PQM");
+#endif
+#if defined(TRANS_SEMILAG_PLM)
+   const string transReconstructionDefault("PLM");
+#elif defined(TRANS_SEMILAG_PQM)
+   const string transReconstructionDefault("PQM");
+#else
+   const string transReconstructionDefault("PPM");
+#endif
+   RP::add("vlasovsolver.accelerationReconstruction",
+           "Reconstruction in velocity space acceleration: PLM, PPM, PQM, or adaptive (PQM in columns where the "
+           "distribution is significant, PPM elsewhere). Default set by the ACC_SEMILAG_ compile flag.",
+           accReconstructionDefault);
+   RP::add("vlasovsolver.translationReconstruction",
+           "Reconstruction in spatial translation without AMR: PLM, PPM, PQM or adaptive. Orders needing a wider "
+           "stencil than compiled in with the TRANS_SEMILAG_ flag are not available. The AMR translation always uses PPM. "
+           "Default set by the TRANS_SEMILAG_ compile flag.",
+           transReconstructionDefault);
+   RP::add("vlasovsolver.adaptiveReconstructionThreshold",
+           "With adaptive reconstruction, PQM is used where any value in the stencil or column exceeds this many "
+           "times the sparsity threshold of the population. Default 10.",
+           10.0);
+   RP::add("vlasovsolver.iterativeAccelerationTransform",
+           "Build the acceleration transform by composing the 0.1 degree rotation substeps one by one, as a reference "
+           "for the closed form used by default. Default false.",
+           false);
 
    // Load balancing parameters
    RP::add("loadBalance.algorithm", "Load balancing algorithm to be used", string("RCB"));
@@ -479,6 +560,7 @@ bool P::addParameters() {
    RP::add("AMR.alpha2_refine_threshold","Determines the minimum value of alpha_2 to refine cells", 0.5);
    RP::add("AMR.alpha2_coarsen_threshold","Determines the maximum value of alpha_2 to unrefine cells, default half of the refine threshold", -1.0);
    RP::add("AMR.refine_cadence","Refine every nth load balance", 5);
+   RP::add("AMR.balance_before_refine","If true, balance load for the refined grid before adapting refinement and skip the load balance after it, so velocity data migrates only once", false);
    RP::add("AMR.refine_after","Start refinement after this many simulation seconds", 0.0);
    RP::add("AMR.refine_radius","Maximum distance from Earth to refine", LARGE_REAL);
    RP::add("AMR.alpha1_drho_weight","Multiplier for delta rho in alpha calculation", 1.0);
@@ -515,6 +597,8 @@ void Parameters::getParameters() {
    typedef Readparameters RP;
    // get numerical values of the parameters
    RP::get("io.diagnostic_write_interval", P::diagnosticInterval);
+   RP::get("io.telemetry_interval", P::telemetryInterval);
+   RP::get("io.telemetry_file_name", P::telemetryFileName);
    RP::get("io.diagnostic_write_all_data_reducers", P::diagnosticWriteAllDROs);
    RP::get("io.system_write_t_interval", P::systemWriteTimeInterval);
    RP::get("io.system_write_file_name", P::systemWriteName);
@@ -687,6 +771,8 @@ void Parameters::getParameters() {
    RP::get("propagate_vlasov_acceleration", P::propagateVlasovAcceleration);
    RP::get("propagate_vlasov_translation", P::propagateVlasovTranslation);
    RP::get("dynamic_timestep", P::dynamicTimestep);
+   RP::get("timed_barriers", P::timedBarriers);
+   RP::get("report_numa_locality", P::reportNumaLocality);
    Real hallRho;
    RP::get("hallMinimumRho", hallRho);
    P::hallMinimumRhom = hallRho * physicalconstants::MASS_PROTON;
@@ -774,6 +860,7 @@ void Parameters::getParameters() {
    }
 
    RP::get("AMR.refine_cadence",P::refineCadence);
+   RP::get("AMR.balance_before_refine",P::balanceBeforeRefine);
    RP::get("AMR.refine_after",P::refineAfter);
    RP::get("AMR.refine_radius",P::refineRadius);
    RP::get("AMR.alpha1_drho_weight", P::alphaDRhoWeight);
@@ -921,6 +1008,25 @@ void Parameters::getParameters() {
    RP::get("vlasovsolver.maxCFL", P::vlasovSolverMaxCFL);
    RP::get("vlasovsolver.minCFL", P::vlasovSolverMinCFL);
    RP::get("vlasovsolver.accelerateMaxwellianBoundaries",  P::vlasovAccelerateMaxwellianBoundaries);
+   RP::get("vlasovsolver.localAccelerationSubcycles",  P::vlasovLocalAccelerationSubcycles);
+   RP::get("vlasovsolver.onTheFlyMoments",  P::vlasovOnTheFlyMoments);
+   RP::get("vlasovsolver.threadedAccelerationBlocks",  P::vlasovThreadedAccelerationBlocks);
+   RP::get("vlasovsolver.packedGhostTransfers",  P::vlasovPackedGhostTransfers);
+   RP::get("vlasovsolver.iterativeAccelerationTransform",  P::vlasovIterativeAccelerationTransform);
+   RP::get("vlasovsolver.adaptiveReconstructionThreshold",  P::vlasovAdaptiveReconstructionThreshold);
+   string accReconstructionString, transReconstructionString;
+   RP::get("vlasovsolver.accelerationReconstruction", accReconstructionString);
+   RP::get("vlasovsolver.translationReconstruction", transReconstructionString);
+   P::vlasovAccelerationReconstruction = parseReconstructionOrder(accReconstructionString);
+   P::vlasovTranslationReconstruction = parseReconstructionOrder(transReconstructionString);
+   // PLM needs one ghost cell, PPM (h4 faces) two and PQM (h6 faces) three
+   const int transStencilWidth = P::vlasovTranslationReconstruction == reconstruction::PLM ? 1 :
+                                 P::vlasovTranslationReconstruction == reconstruction::PPM ? 2 : 3;
+   if (transStencilWidth > VLASOV_STENCIL_WIDTH) {
+      cerr << "Translation reconstruction " << transReconstructionString << " needs a stencil width of "
+           << transStencilWidth << ", only " << VLASOV_STENCIL_WIDTH << " compiled in, see TRANS_SEMILAG_ in the Makefile" << endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+   }
 
    // Get load balance parameters
    RP::get("loadBalance.algorithm", P::loadBalanceAlgorithm);
@@ -74,6 +74,8 @@ struct Parameters {
    static std::vector<CellID> localCells; /*!< Cached copy of spatial cell IDs on this process.*/
 
    static uint diagnosticInterval;
+   static uint telemetryInterval;          /*!< Append a row of performance telemetry every this many time steps, 0 disables */
+   static std::string telemetryFileName;   /*!< Name of the performance telemetry CSV file */
    static std::vector<std::string> systemWriteName;  /*!< Names for the different classes of grid output*/
    static std::vector<std::string> systemWritePath;  /*!< Save this series in this location. Default is ./ */
    static std::vector<Real> systemWriteTimeInterval; /*!< Interval in simusecond for output for each class*/
@@ -148,6 +150,14 @@ struct Parameters {
    static Real maxSlAccelerationRotation; /*!< Maximum rotation in acceleration for semilagrangian solver*/
    static int maxSlAccelerationSubcycles; /*!< Maximum number of subcycles in acceleration*/
    static bool vlasovAccelerateMaxwellianBoundaries; /*!< Accelerate also Maxwellian boundary cells*/
+   static bool vlasovLocalAccelerationSubcycles; /*!< Subcycle acceleration cell by cell, without global lockstep*/
+   static bool vlasovOnTheFlyMoments; /*!< Accumulate _V moments in the acceleration write-back between local subcycles*/
+   static uint vlasovThreadedAccelerationBlocks; /*!< Cells with at least this many blocks are accelerated by all threads together, 0 disables*/
+   static bool vlasovPackedGhostTransfers; /*!< Pack translation ghost cell velocity block data before sending it*/
+   static bool vlasovIterativeAccelerationTransform; /*!< Build the acceleration transform substep by substep (reference mode)*/
+   static int vlasovAccelerationReconstruction; /**< Reconstruction in acceleration, one of reconstruction::Order.*/
+   static int vlasovTranslationReconstruction; /**< Reconstruction in non-AMR translation, one of reconstruction::Order.*/
+   static Real vlasovAdaptiveReconstructionThreshold; /**< ADAPTIVE uses PQM where values exceed this times the sparsity threshold.*/
 
    static Real hallMinimumRhom; /*!< Minimum mass density value used in the field solver.*/
    static Real hallMinimumRhoq; /*!< Minimum charge density value used for the Hall and electron pressure gradient terms
@@ -170,6 +180,8 @@ struct Parameters {
    static int
        writeRestartAsFloat;     /*!< true if writing into restart files in floats instead of doubles, false otherwise */
    static bool dynamicTimestep; /*!< If true, timestep is set based on  CFL limit */
+   static bool timedBarriers;   /*!< If true, global MPI barriers are inserted between solver phases for profiling */
+   static bool reportNumaLocality; /*!< If true, memory reports include resident memory on local and remote NUMA nodes */
 
    static std::string projectName; /*!< Project to be used in this run. */
 
@@ -199,6 +211,7 @@ struct Parameters {
    static Real jperbRefineThreshold;
    static Real jperbCoarsenThreshold;
    static uint refineCadence;
+   static bool balanceBeforeRefine; /*!< Balance load for the refined grid before refining, instead of after */
    static Real refineAfter;
    static Real refineRadius;
    static Real alphaDRhoWeight;
@@ -21,6 +21,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <vector>
+#include <cmath>
 #include "vectorclass.h"
 #include "vector3d.h"
 #include "boundaries.h"
@@ -136,6 +137,76 @@ struct Field
       return operator()(v);
    }
 
+   // Batched interpolation at n positions, given as separate x, y and z arrays
+   // (n <= PARTICLE_BATCH_SIZE). Gives the same values as operator(), but only
+   // maps the cell coordinates of the two neighbouring cells in each direction
+   // through the boundaries, instead of every interpolation corner.
+   virtual void gather(int n, const double* const pos[3], double* const out[3]) {
+      for(int i=0; i<n; i++) {
+         int c0[3],c1[3];
+         double fract[3];
+         for(int d=0; d<3; d++) {
+            const double v = (pos[d][i] - dimension[d]->min) / dx[d];
+            const int index = (int)v;
+            fract[d] = v - trunc(v);
+            c0[d] = dimension[d]->cellCoordinate(index);
+            c1[d] = dimension[d]->cellCoordinate(index+1);
+         }
+
+         const double* interp[8];
+         double weight[8];
+         int corners;
+         if(dimension[2]->cells <= 1) {
+            // Equatorial plane
+            interp[0] = getCellRef(c0[0],c0[1],c0[2]);
+            interp[1] = getCellRef(c1[0],c0[1],c0[2]);
+            interp[2] = getCellRef(c0[0],c1[1],c0[2]);
+            interp[3] = getCellRef(c1[0],c1[1],c0[2]);
+            weight[0] = (1.-fract[0])*(1.-fract[1]);
+            weight[1] = fract[0]*(1.-fract[1]);
+            weight[2] = (1.-fract[0])*fract[1];
+            weight[3] = fract[0]*fract[1];
+            corners = 4;
+         } else if (dimension[1]->cells <= 1) {
+            // Polar plane
+            interp[0] = getCellRef(c0[0],c0[1],c0[2]);
+            interp[1] = getCellRef(c1[0],c0[1],c0[2]);
+            interp[2] = getCellRef(c0[0],c0[1],c1[2]);
+            interp[3] = getCellRef(c1[0],c0[1],c1[2]);
+            weight[0] = (1.-fract[0])*(1.-fract[2]);
+            weight[1] = fract[0]*(1.-fract[2]);
+            weight[2] = (1.-fract[0])*fract[2];
+            weight[3] = fract[0]*fract[2];
+            corners = 4;
+         } else {
+            // Proper 3D, with the same z weights as operator()
+            interp[0] = getCellRef(c0[0],c0[1],c0[2]);
+            interp[1] = getCellRef(c1[0],c0[1],c0[2]);
+            interp[2] = getCellRef(c0[0],c1[1],c0[2]);
+            interp[3] = getCellRef(c1[0],c1[1],c0[2]);
+            interp[4] = getCellRef(c0[0],c0[1],c1[2]);
+            interp[5] = getCellRef(c1[0],c0[1],c1[2]);
+            interp[6] = getCellRef(c0[0],c1[1],c1[2]);
+            interp[7] = getCellRef(c1[0],c1[1],c1[2]);
+            const double wz[2] = {fract[2], 1.-fract[2]};
+            for(int z=0; z<2; z++) {
+               weight[4*z+0] = wz[z]*(1.-fract[0])*(1.-fract[1]);
+               weight[4*z+1] = wz[z]*fract[0]*(1.-fract[1]);
+               weight[4*z+2] = wz[z]*(1.-fract[0])*fract[1];
+               weight[4*z+3] = wz[z]*fract[0]*fract[1];
+            }
+            corners = 8;
+         }
+
+         for(int c=0; c<3; c++) {
+            double sum = 0;
+            for(int k=0; k<corners; k++) {
+               sum += weight[k] * interp[k][c];
+            }
+            out[c][i] = sum;
+         }
+      }
+   }
 };
 
 // Linear Temporal interpolation between two input fields
@@ -157,4 +228,19 @@ struct Interpolated_Field : Field{
       double fract = (t - a.time)/(b.time-a.time);
       return fract*bval + (1.-fract)*aval;
    }
+
+   virtual void gather(int n, const double* const pos[3], double* const out[3]) {
+      double bbuf[3][PARTICLE_BATCH_SIZE];
+      double* const bval[3] = {bbuf[0], bbuf[1], bbuf[2]};
+      a.gather(n, pos, out);
+      b.gather(n, pos, bval);
+
+      double fract = (t - a.time)/(b.time-a.time);
+      for(int c=0; c<3; c++) {
+         #pragma omp simd
+         for(int i=0; i<n; i++) {
+            out[c][i] = fract*bval[c][i] + (1.-fract)*out[c][i];
+         }
+      }
+   }
 };
@@ -27,6 +27,7 @@
 #include <iostream>
 #include <random>
 #include <string.h>
+#include <algorithm>
 #include "particles.h"
 #include "field.h"
 #include "physconst.h"
@@ -37,6 +38,53 @@
 #include "scenario.h"
 #include "boundaries.h"
 
+/* Push n consecutive particles: their positions and velocities are copied into
+ * separate x, y and z arrays, the fields are gathered for the whole batch and
+ * the Boris push then runs vectorized across the particles. */
+static void pushBatch(Particle* p, int n, Field& E, Field& B, double dt) {
+   double xbuf[3][PARTICLE_BATCH_SIZE], vbuf[3][PARTICLE_BATCH_SIZE];
+   double Ebuf[3][PARTICLE_BATCH_SIZE], Bbuf[3][PARTICLE_BATCH_SIZE];
+   double qm[PARTICLE_BATCH_SIZE];
+   bool active[PARTICLE_BATCH_SIZE];
+   double* const x[3] = {xbuf[0], xbuf[1], xbuf[2]};
+   double* const v[3] = {vbuf[0], vbuf[1], vbuf[2]};
+   double* const Eval[3] = {Ebuf[0], Ebuf[1], Ebuf[2]};
+   double* const Bval[3] = {Bbuf[0], Bbuf[1], Bbuf[2]};
+
+   for(int i=0; i<n; i++) {
+      // Disabled particles are pushed along at the origin of the box, but not stored back.
+      active[i] = isfinite(vector_length(p[i].x));
+      for(int d=0; d<3; d++) {
+         x[d][i] = active[i] ? p[i].x[d] : B.dimension[d]->min;
+         v[d][i] = active[i] ? p[i].v[d] : 0.;
+      }
+      qm[i] = p[i].q / p[i].m;
+   }
+
+   /* Get E- and B-Field at their position */
+   E.gather(n, x, Eval);
+   B.gather(n, x, Bval);
+
+   if(dt < 0) {
+      // If propagating backwards in time, flip B-field pseudovector
+      for(int d=0; d<3; d++) {
+         for(int i=0; i<n; i++) {
+            Bval[d][i] *= -1;
+         }
+      }
+   }
+
+   /* Push them around */
+   borisPush(n, x, v, Eval, Bval, qm, dt);
+
+   for(int i=0; i<n; i++) {
+      if(active[i]) {
+         p[i].x = Vec3d(x[0][i], x[1][i], x[2][i]);
+         p[i].v = Vec3d(v[0][i], v[1][i], v[2][i]);
+      }
+   }
+}
+
 int main(int argc, char** argv) {
 
    MPI_Init(&argc, &argv);
@@ -97,6 +145,8 @@ int main(int argc, char** argv) {
    Scenario* scenario = createScenario(ParticleParameters::mode);
    ParticleContainer particles = scenario->initialParticles(E[0],B[0],V);
 
+   std::vector<char> keep;
+
    std::cerr << "Pushing " << particles.size() << " particles for " << maxsteps << " steps..." << std::endl;
    std::cerr << "[                                                                        ]\x0d[";
 
@@ -123,52 +173,24 @@ int main(int argc, char** argv) {
 
       scenario->beforePush(particles,cur_E,cur_B,V);
 
-#pragma omp parallel for
-      for(unsigned int i=0; i< particles.size(); i++) {
-
-         if(!isfinite(vector_length(particles[i].x))) {
-            // Skip disabled particles.
-            continue;
-         }
-
-         /* Get E- and B-Field at their position */
-         Vec3d Eval,Bval;
-
-         Eval = cur_E(particles[i].x);
-         Bval = cur_B(particles[i].x);
-
-         if(dt < 0) {
-           // If propagating backwards in time, flip B-field pseudovector
-           Bval *= -1;
-         }
-
-         /* Push them around */
-         particles[i].push(Bval,Eval,dt);
-
+#pragma omp parallel for schedule(static)
+      for(size_t first=0; first < particles.size(); first += PARTICLE_BATCH_SIZE) {
+         const int n = std::min<size_t>(PARTICLE_BATCH_SIZE, particles.size() - first);
+         pushBatch(&particles[first], n, cur_E, cur_B, dt);
       }
 
-      // Remove all particles that have left the simulation box after this step
-      // (unfortunately, this can not be done in parallel, so it better be fast!)
-      for(auto i = particles.begin(); i != particles.end(); ) {
-
-         // Boundaries are allowed to mangle the particles here.
-         // If they return false, particles are deleted.
-         bool do_erase = false;
-         if(!ParticleParameters::boundary_behaviour_x->handleParticle(*i)) {
-            do_erase = true;
-         }
-         if(!ParticleParameters::boundary_behaviour_y->handleParticle(*i)) {
-            do_erase = true;
-         }
-         if(!ParticleParameters::boundary_behaviour_z->handleParticle(*i)) {
-            do_erase = true;
-         }
-         if(do_erase) {
-            particles.erase(i);
-         } else {
-            i++;
-         }
+      // Remove all particles that have left the simulation box after this step.
+      // Boundaries are allowed to mangle the particles here.
+      // If they return false, particles are deleted.
+      keep.resize(particles.size());
+#pragma omp parallel for schedule(static)
+      for(size_t i=0; i < particles.size(); i++) {
+         const bool keep_x = ParticleParameters::boundary_behaviour_x->handleParticle(particles[i]);
+         const bool keep_y = ParticleParameters::boundary_behaviour_y->handleParticle(particles[i]);
+         const bool keep_z = ParticleParameters::boundary_behaviour_z->handleParticle(particles[i]);
+         keep[i] = keep_x && keep_y && keep_z;
       }
+      removeParticles(particles, keep);
 
       scenario->afterPush(step, step*dt, particles, cur_E, cur_B, V);
 
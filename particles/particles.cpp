@@ -20,6 +20,8 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <vector>
+#include <algorithm>
+#include <omp.h>
 #include "particles.h"
 #include "physconst.h"
 #include "relativistic_math.h"
@@ -42,6 +44,82 @@ void Particle::push(Vec3d& B, Vec3d& E, double dt) {
    x += dt * v;
 }
 
+void borisPush(int n, double* const x[3], double* const v[3], const double* const E[3],
+      const double* const B[3], const double* qm, double dt) {
+
+   const double c2 = PhysicalConstantsSI::c * PhysicalConstantsSI::c;
+
+   #pragma omp simd
+   for(int i=0; i<n; i++) {
+      const double a = 0.5 * qm[i] * dt;
+
+      // Half acceleration by E
+      const double umx = v[0][i] + a * E[0][i];
+      const double umy = v[1][i] + a * E[1][i];
+      const double umz = v[2][i] + a * E[2][i];
+
+      // Rotation by B
+      const double g = sqrt(1. + (umx*umx + umy*umy + umz*umz) / c2);
+      double hx = a * B[0][i] / g;
+      double hy = a * B[1][i] / g;
+      double hz = a * B[2][i] / g;
+      const double upx = umx + (umy*hz - umz*hy);
+      const double upy = umy + (umz*hx - umx*hz);
+      const double upz = umz + (umx*hy - umy*hx);
+      const double s = 2. / (1. + hx*hx + hy*hy + hz*hz);
+      hx *= s;
+      hy *= s;
+      hz *= s;
+
+      // Second half acceleration by E, and position update
+      v[0][i] = umx + (upy*hz - upz*hy) + a * E[0][i];
+      v[1][i] = umy + (upz*hx - upx*hz) + a * E[1][i];
+      v[2][i] = umz + (upx*hy - upy*hx) + a * E[2][i];
+      x[0][i] += dt * v[0][i];
+      x[1][i] += dt * v[1][i];
+      x[2][i] += dt * v[2][i];
+   }
+}
+
+void removeParticles(ParticleContainer& p, const std::vector<char>& keep) {
+
+   const size_t n = p.size();
+   std::vector<size_t> kept(omp_get_max_threads() + 1, 0);
+   int nThreads = 1;
+
+   /* Each thread compacts its own contiguous chunk in place... */
+   #pragma omp parallel
+   {
+      const int t = omp_get_thread_num();
+      #pragma omp single
+      nThreads = omp_get_num_threads();
+
+      const size_t begin = n * t / nThreads;
+      const size_t end = n * (t+1) / nThreads;
+      size_t out = begin;
+      for(size_t i=begin; i<end; i++) {
+         if(keep[i]) {
+            if(out != i) {
+               p[out] = p[i];
+            }
+            out++;
+         }
+      }
+      kept[t+1] = out - begin;
+   }
+
+   /* ...and the chunks are then moved together in order. */
+   size_t total = kept[1];
+   for(int t=1; t<nThreads; t++) {
+      const size_t begin = n * t / nThreads;
+      if(total != begin) {
+         std::move(p.begin() + begin, p.begin() + begin + kept[t+1], p.begin() + total);
+      }
+      total += kept[t+1];
+   }
+   p.erase(p.begin() + total, p.end());
+}
+
 void writeParticles(ParticleContainer& p,const char* filename) {
 
    vlsv::Writer vlsvWriter;
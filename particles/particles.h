@@ -43,5 +43,17 @@ struct Particle {
 
 typedef std::vector<Particle, aligned_allocator<Particle, 32>> ParticleContainer;
 
+/* Number of particles that are pushed together as one structure-of-arrays batch */
+const int PARTICLE_BATCH_SIZE = 64;
+
+/* Boris push of n particles, with positions, velocities and fields given as
+ * separate x, y and z arrays so that the loop vectorizes across particles.
+ * Same relativistic scheme as Particle::push, qm is the charge to mass ratio. */
+void borisPush(int n, double* const x[3], double* const v[3], const double* const E[3],
+      const double* const B[3], const double* qm, double dt);
+
+/* Remove all particles whose keep flag is zero, preserving the order of the rest */
+void removeParticles(ParticleContainer& p, const std::vector<char>& keep);
+
 void writeParticles(ParticleContainer& p, const char* filename);
 
@@ -30,6 +30,7 @@
 #include <string>
 #include <set>
 #include <cstring>
+#include <future>
 
 #define DEBUG
 
@@ -103,9 +104,11 @@ static void detect_field_names(Reader& r) {
    std::cerr << E_field_name << std::endl;
 }
 
-/* Read the "raw" field data in file order */
+/* Read the "raw" field data in file order into buffer, reusing its storage.
+ * Single precision data is staged through floatBuffer. */
 template <class Reader>
-std::vector<double> readFieldData(Reader& r, std::string& name, unsigned int numcomponents) {
+void readFieldData(Reader& r, std::string& name, unsigned int numcomponents, std::vector<double>& buffer,
+      std::vector<float>& floatBuffer) {
 
    uint64_t arraySize=0;
    uint64_t vectorSize=0;
@@ -120,41 +123,44 @@ std::vector<double> readFieldData(Reader& r, std::string& name, unsigned int num
    }
 
    if(byteSize == 8) {
-      /* Allocate memory for the data */
-      std::vector<double> buffer(arraySize*vectorSize);
-      
+      buffer.resize(arraySize*vectorSize);
+
       if( r.readArray("VARIABLE",attribs,0,arraySize,(char*) buffer.data()) == false) {
          std::cerr << "readArray failed when trying to read VARIABLE \"" << name << "\"." << std::endl;
          exit(1);
       }
-      
-      return buffer;
    } else if(byteSize == 4) {
-      /* Allocate memory for the data */
-      std::vector<double> buffer;
-      std::vector<float>  fbuffer(arraySize*vectorSize);
-      
-      if( r.readArray("VARIABLE",attribs,0,arraySize,(char*) fbuffer.data()) == false) {
+      floatBuffer.resize(arraySize*vectorSize);
+
+      if( r.readArray("VARIABLE",attribs,0,arraySize,(char*) floatBuffer.data()) == false) {
          std::cerr << "readArray faied when trying to read VARIABLE \"" << name << "\"." << std::endl;
          exit(1);
       }
-      
-      for(float value : fbuffer) {
-         buffer.push_back((double)value);
+
+      buffer.resize(floatBuffer.size());
+      for(size_t i=0; i<floatBuffer.size(); i++) {
+         buffer[i] = (double)floatBuffer[i];
       }
-      
-      return buffer;
    } else {
       std::cerr << "Datatype of VARIABLE \"" << name << "\" entries is not double." << std::endl;
       exit(1);
    }
-   
-   return {0};
 }
 
-/* Read the "raw" FsGrid data in file order */
+/* Read the "raw" field data in file order */
 template <class Reader>
-std::vector<double> readFsGridData(Reader& r, std::string& name, unsigned int numcomponents) {
+std::vector<double> readFieldData(Reader& r, std::string& name, unsigned int numcomponents) {
+   std::vector<double> buffer;
+   std::vector<float> floatBuffer;
+   readFieldData(r,name,numcomponents,buffer,floatBuffer);
+   return buffer;
+}
+
+/* Read the "raw" FsGrid data in file order into buffer, reusing its storage.
+ * The data of the writing ranks is staged through readBuffer. */
+template <class Reader>
+void readFsGridData(Reader& r, std::string& name, unsigned int numcomponents, std::vector<double>& buffer,
+      std::vector<Real>& readBuffer) {
 
    uint64_t arraySize;
    uint64_t vectorSize;
@@ -191,8 +197,8 @@ std::vector<double> readFsGridData(Reader& r, std::string& name, unsigned int nu
 
    // Determine our tasks storage size
    size_t storageSize = size[0]*size[1]*size[2];
-   std::vector<Real> buffer(storageSize*numcomponents);
-   std::vector<Real> readBuffer(storageSize*numcomponents);
+   buffer.resize(storageSize*numcomponents);
+   readBuffer.resize(storageSize*numcomponents);
 
    if(r.readArray("VARIABLE",attribs,0,arraySize,(char*) readBuffer.data()) == false) {
       std::cerr << "readArray faied when trying to read VARIABLE \"" << name << "\"." << std::endl;
@@ -263,9 +269,99 @@ std::vector<double> readFsGridData(Reader& r, std::string& name, unsigned int nu
       }
       fileOffset += overlapSize[0] * overlapSize[1] * overlapSize[2];
    }
+}
+
+/* Read the "raw" FsGrid data in file order */
+template <class Reader>
+std::vector<double> readFsGridData(Reader& r, std::string& name, unsigned int numcomponents) {
+   std::vector<double> buffer;
+   std::vector<Real> readBuffer;
+   readFsGridData(r,name,numcomponents,buffer,readBuffer);
    return buffer;
 }
 
+/* Field data of one input file, in file order, as loaded by readTimestepData.
+ * The buffers are kept between files, so they are only reallocated if the
+ * next file is larger. */
+struct TimestepData {
+   int file_index = -1; // Input file counter of the data, -1 if nothing loaded
+   bool valid = false;  // False if the file could not be opened
+   double time;
+   std::vector<uint64_t> cellIds;
+   std::vector<double> E, B, V;
+   std::vector<double> scratch; // Perturbed B or rho, before they are combined into B or V
+   std::vector<float> floatReadBuffer; // Staging for single precision variables
+   std::vector<Real> fsgridReadBuffer; // Staging for fsgrid variables in writing rank order
+};
+
+/* Read E, B and (optionally) V of the given input file into d. This runs in
+ * the background while the particles are pushed, so that the next file is
+ * already in memory when readNextTimestep needs it. */
+template <class Reader>
+void readTimestepData(const std::string filename, bool doV, TimestepData* d, int file_index) {
+
+   d->file_index = file_index;
+   d->valid = false;
+
+   Reader r;
+   if(!r.open(filename)) {
+      return;
+   }
+   if(!r.readParameter("time",d->time)) {
+      if(!r.readParameter("t",d->time)) {
+         std::cerr << "Time parameter in file " << filename << " is neither 't' nor 'time'. Bad file format?"
+            << std::endl;
+         exit(1);
+      }
+   }
+
+   /* Read CellIDs and Field data */
+   d->cellIds = readCellIds(r);
+   std::string name(B_field_name);
+   if (B_field_name == "fg_b" || B_field_name == "fg_b_background") {
+      readFsGridData(r,name,3u,d->B,d->fsgridReadBuffer);
+      if (B_field_name == "fg_b_background") {
+         name = "fg_b_perturbed";
+         readFsGridData(r,name,3u,d->scratch,d->fsgridReadBuffer);
+         for (size_t i = 0; i < d->B.size(); ++i) {
+            d->B[i] += d->scratch[i];
+         }
+      }
+      name = E_field_name;
+      readFsGridData(r,name,3u,d->E,d->fsgridReadBuffer);
+      for (size_t i = 0; i < d->cellIds.size(); ++i) {
+         d->cellIds[i] = i+1;
+      }
+   } else {
+      readFieldData(r,name,3u,d->B,d->floatReadBuffer);
+      if (B_field_name == "vg_b_background_vol") {
+         name = "vg_b_perturbed_vol";
+         readFieldData(r,name,3u,d->scratch,d->floatReadBuffer);
+         for (size_t i = 0; i < d->B.size(); ++i) {
+            d->B[i] += d->scratch[i];
+         }
+      }
+      name = E_field_name;
+      readFieldData(r,name,3u,d->E,d->floatReadBuffer);
+   }
+   if(doV) {
+      name = ParticleParameters::V_field_name;
+      readFieldData(r,name,3u,d->V,d->floatReadBuffer);
+      if(ParticleParameters::divide_rhov_by_rho) {
+         name = ParticleParameters::rho_field_name;
+         readFieldData(r,name,1u,d->scratch,d->floatReadBuffer);
+         for(size_t i=0; i<d->scratch.size(); i++) {
+            d->V[3*i] /= d->scratch[i];
+            d->V[3*i+1] /= d->scratch[i];
+            d->V[3*i+2] /= d->scratch[i];
+         }
+      }
+   }
+
+   r.close();
+   d->valid = true;
+}
+
 /* Read the next logical input file. Depending on sign of dt,
  * this may be a numerically larger or smaller file.
  * Return value: true if a new file was read, otherwise false.
@@ -275,6 +371,11 @@ template <class Reader>
 bool readNextTimestep(const std::string& filename_pattern, double t, int step, Field& E0, Field& E1,
       Field& B0, Field& B1, Field& V, bool doV, int& input_file_counter) {
 
+   // The next input file is loaded in the background into data, while the
+   // particles are pushed through the current E0/E1 interval.
+   static TimestepData data;
+   static std::future<void> prefetch;
+
    char filename_buffer[256];
    bool retval = false;
 
@@ -283,101 +384,60 @@ bool readNextTimestep(const std::string& filename_pattern, double t, int step, F
 
       E0=E1;
       B0=B1;
-      snprintf(filename_buffer,256,filename_pattern.c_str(),input_file_counter);
-
-      /* Open next file */
-      Reader r;
-      r.open(filename_buffer);
-      double t;
-      if(!r.readParameter("time",t)) {
-         if(!r.readParameter("t",t)) {
-            std::cerr << "Time parameter in file " << filename_buffer << " is neither 't' nor 'time'. Bad file format?"
-               << std::endl;
+
+      /* Wait for the prefetched file, or read it now if it is not the one we need */
+      if(prefetch.valid()) {
+         prefetch.get();
+      }
+      if(!data.valid || data.file_index != input_file_counter) {
+         snprintf(filename_buffer,256,filename_pattern.c_str(),input_file_counter);
+         readTimestepData<Reader>(filename_buffer, doV, &data, input_file_counter);
+         if(!data.valid) {
+            std::cerr << "Could not open input file " << filename_buffer << std::endl;
             exit(1);
          }
       }
 
-      E1.time = t;
-      B1.time = t;
+      E1.time = data.time;
+      B1.time = data.time;
 
       uint64_t cells[3];
-      r.readParameter("xcells_ini",cells[0]);
-      r.readParameter("ycells_ini",cells[1]);
-      r.readParameter("zcells_ini",cells[2]);
-
-      /* Read CellIDs and Field data */
-      std::vector<uint64_t> cellIds = readCellIds(r);
-      std::string name(B_field_name);
-      std::vector<double> Bbuffer;
-      std::vector<double> Ebuffer;
-      if (B_field_name == "fg_b" || B_field_name == "fg_b_background") {
-         Bbuffer = readFsGridData(r,name,3u);
-         if (B_field_name == "fg_b_background") {
-            name = "fg_b_perturbed";
-            std::vector<double> perturbedBbuffer = readFsGridData(r,name,3u);
-            for (int i = 0; i < Bbuffer.size(); ++i) {
-               Bbuffer[i] += perturbedBbuffer[i];
-            }
-         }
-         name = E_field_name;
-         Ebuffer = readFsGridData(r,name,3u);
-         for (int i = 0; i < cellIds.size(); ++i) {
-            cellIds[i] = i+1;
-         }
-      } else {
-         Bbuffer = readFieldData(r,name,3u);
-         if (B_field_name == "vg_b_background_vol") {
-            name = "vg_b_perturbed_vol";
-            std::vector<double> perturbedBbuffer = readFieldData(r,name,3u);
-            for (int i = 0; i < Bbuffer.size(); ++i) {
-               Bbuffer[i] += perturbedBbuffer[i];
-            }
-         }
-         name = E_field_name;
-         Ebuffer = readFieldData(r,name,3u);
-      }
-      std::vector<double> Vbuffer;
-      if(doV) {
-        name = ParticleParameters::V_field_name;
-        std::vector<double> rho_v_buffer = readFieldData(r,name,3u);
-        if(ParticleParameters::divide_rhov_by_rho) {
-          name = ParticleParameters::rho_field_name;
-          std::vector<double> rho_buffer = readFieldData(r,name,1u);
-          for(unsigned int i=0; i<rho_buffer.size(); i++) {
-            Vbuffer.push_back(rho_v_buffer[3*i] / rho_buffer[i]);
-            Vbuffer.push_back(rho_v_buffer[3*i+1] / rho_buffer[i]);
-            Vbuffer.push_back(rho_v_buffer[3*i+2] / rho_buffer[i]);
-          }
-        }
-      }
+      cells[0] = E1.dimension[0]->cells;
+      cells[1] = E1.dimension[1]->cells;
+      cells[2] = E1.dimension[2]->cells;
 
       /* Assign them, without sanity checking */
       /* TODO: Is this actually a good idea? */
-      for(uint i=0; i< cellIds.size(); i++) {
-         uint64_t c = cellIds[i];
+      #pragma omp parallel for
+      for(uint i=0; i< data.cellIds.size(); i++) {
+         uint64_t c = data.cellIds[i];
          int64_t x = c % cells[0];
          int64_t y = (c /cells[0]) % cells[1];
          int64_t z = c /(cells[0]*cells[1]);
 
          double* Etgt = E1.getCellRef(x,y,z);
          double* Btgt = B1.getCellRef(x,y,z);
-         Etgt[0] = Ebuffer[3*i];
-         Etgt[1] = Ebuffer[3*i+1];
-         Etgt[2] = Ebuffer[3*i+2];
-         Btgt[0] = Bbuffer[3*i];
-         Btgt[1] = Bbuffer[3*i+1];
-         Btgt[2] = Bbuffer[3*i+2];
+         Etgt[0] = data.E[3*i];
+         Etgt[1] = data.E[3*i+1];
+         Etgt[2] = data.E[3*i+2];
+         Btgt[0] = data.B[3*i];
+         Btgt[1] = data.B[3*i+1];
+         Btgt[2] = data.B[3*i+2];
 
          if(doV) {
            double* Vtgt = V.getCellRef(x,y,z);
-           Vtgt[0] = Vbuffer[3*i];
-           Vtgt[1] = Vbuffer[3*i+1];
-           Vtgt[2] = Vbuffer[3*i+2];
+           Vtgt[0] = data.V[3*i];
+           Vtgt[1] = data.V[3*i+1];
+           Vtgt[2] = data.V[3*i+2];
          }
       }
-
-      r.close();
       retval = true;
+
+      /* Start loading the following file. If it does not exist, this just
+       * leaves data invalid. */
+      snprintf(filename_buffer,256,filename_pattern.c_str(),input_file_counter+step);
+      prefetch = std::async(std::launch::async, readTimestepData<Reader>, std::string(filename_buffer), doV,
+            &data, input_file_counter+step);
    }
 
    return retval;
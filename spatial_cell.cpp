@@ -20,6 +20,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
 #include <unordered_set>
 
 #include "spatial_cell.hpp"
@@ -39,6 +40,9 @@ namespace spatial_cell {
    bool SpatialCell::mpiTransferInAMRTranslation = false;
    int SpatialCell::mpiTransferXYZTranslation = 0;
 
+   /** Number of 64-bit words in the non-zero mask of a packed velocity block.*/
+   static const uint PACKED_MASK_WORDS = (WID3 + 63) / 64;
+
    SpatialCell::SpatialCell() {
       // Block list and cache always have room for all blocks
       this->sysBoundaryLayer=0; // Default value, layer not yet initialized
@@ -61,6 +65,7 @@ namespace spatial_cell {
       
       //is transferred by default
       this->mpiTransferEnabled=true;
+      this->packed_block_data_size = 0;
       
       // Set correct number of populations
       populations.resize(getObjectWrapper().particleSpecies.size());
@@ -74,6 +79,59 @@ namespace spatial_cell {
       }
    }
 
+   #ifndef VAMR
+   /** Dilate a block mask along one axis of its bounding box by addWidth blocks.
+    * The mask is stored with unit stride in x, stride dims[0] in y and
+    * dims[0]*dims[1] in z. Dilation with a cube is separable, so three calls
+    * (one per axis) give the same result as marking the full
+    * (2*addWidth+1)^3 neighbourhood of every marked block.
+    * @param src Mask to dilate.
+    * @param dst Dilated mask, must not alias src.
+    * @param dims Bounding box size in blocks.
+    * @param axis Axis along which to dilate.
+    * @param addWidth Dilation half-width in blocks.*/
+   static void dilateBlockMask(const std::vector<uint8_t>& src,std::vector<uint8_t>& dst,
+                               const int dims[3],const int axis,const int addWidth) {
+      const int stride = (axis == 0) ? 1 : ((axis == 1) ? dims[0] : dims[0]*dims[1]);
+      const int length = dims[axis];
+      const size_t N = (size_t)dims[0]*dims[1]*dims[2];
+      std::fill(dst.begin(),dst.begin()+N,0);
+
+      for (size_t n=0; n<N; ++n) {
+         if (src[n] == 0) continue;
+         const int pos = (n / stride) % length;
+         const int first = std::max(0,pos-addWidth);
+         const int last  = std::min(length-1,pos+addWidth);
+         uint8_t* line = dst.data() + n - (size_t)pos*stride;
+         for (int p=first; p<=last; ++p) line[(size_t)p*stride] = 1;
+      }
+   }
+
+   /** Get the index of a velocity block in a block mask covering the given bounding box.
+    * @param vmesh Velocity mesh the block belongs to.
+    * @param blockGID Global ID of the block.
+    * @param bboxMin Lower corner of the bounding box in block indices.
+    * @param dims Bounding box size in blocks.
+    * @return Index into the mask, or the number of blocks in the bounding box
+    * if the block is invalid or outside of the box.*/
+   static size_t blockMaskIndex(const vmesh::VelocityMesh<vmesh::GlobalID,vmesh::LocalID>& vmesh,const vmesh::GlobalID& blockGID,
+                                const int bboxMin[3],const int dims[3]) {
+      const size_t maskSize = (size_t)dims[0]*dims[1]*dims[2];
+      uint8_t refLevel;
+      vmesh::LocalID indices[3];
+      vmesh.getIndices(blockGID,refLevel,indices[0],indices[1],indices[2]);
+
+      size_t index = 0;
+      for (int d=2; d>=0; --d) {
+         if (indices[d] == vmesh.invalidBlockIndex()) return maskSize;
+         const int i = (int)indices[d]-bboxMin[d];
+         if (i < 0 || i >= dims[d]) return maskSize;
+         index = index*dims[d] + i;
+      }
+      return index;
+   }
+   #endif
+
    /** Adds "important" and removes "unimportant" velocity blocks
     * to/from this cell.
     * 
@@ -106,44 +164,79 @@ namespace spatial_cell {
          exit(1);
       }
       #endif
-      
-      //  This set contains all those cellids which have neighbors in any
-      //  of the 6-dimensions Actually, we would only need to add
-      //  local blocks with no content here, as blocks with content
-      //  do not need to be created and also will not be removed as
-      //  we only check for removal for blocks with no content
-      std::unordered_set<vmesh::GlobalID> neighbors_have_content;
 
-      //add neighbor content info for velocity space neighbors to map. We loop over blocks
-      //with content and raise the neighbors_have_content for
-      //itself, and for all its neighbors
+      // Blocks that have content, or have a velocity or spatial neighbor with
+      // content, are flagged in a dense mask covering the bounding box of
+      // those blocks. The mask buffers are reused between calls on the same
+      // thread, so no memory is allocated once they have grown large enough.
+      static thread_local std::vector<uint8_t> neighbors_have_content;
+      static thread_local std::vector<uint8_t> dilationBuffer;
+      static thread_local std::vector<vmesh::GlobalID> blocksToAdd;
+
+      vmesh::VelocityMesh<vmesh::GlobalID,vmesh::LocalID>& vmesh = populations[popID].vmesh;
+      const vmesh::LocalID* gridLength = vmesh.getGridLength(0);
+      const int addWidthV = getObjectWrapper().particleSpecies[popID].sparseBlockAddWidthV;
+
+      // Compute the bounding box of own content blocks (dilated by addWidthV
+      // and clipped to the velocity grid) and of spatial neighbor content blocks
+      int bboxMin[3] = {(int)gridLength[0],(int)gridLength[1],(int)gridLength[2]};
+      int bboxMax[3] = {-1,-1,-1};
       for (vmesh::LocalID block_index=0; block_index<velocity_block_with_content_list.size(); ++block_index) {
-         vmesh::GlobalID block = velocity_block_with_content_list[block_index];
-
-         const uint8_t refLevel=0;
-         const velocity_block_indices_t indices = SpatialCell::get_velocity_block_indices(popID,block);
-         neighbors_have_content.insert(block); //also add the cell itself
-
-         int addWidthV = getObjectWrapper().particleSpecies[popID].sparseBlockAddWidthV;
-         for (int offset_vx=-addWidthV;offset_vx<=addWidthV;offset_vx++) {
-            for (int offset_vy=-addWidthV;offset_vy<=addWidthV;offset_vy++) {
-               for (int offset_vz=-addWidthV;offset_vz<=addWidthV;offset_vz++) {
-                  const vmesh::GlobalID neighbor_block 
-                     = get_velocity_block(popID,{{indices[0]+offset_vx,indices[1]+offset_vy,indices[2]+offset_vz}},refLevel);
-                  neighbors_have_content.insert(neighbor_block); //add all potential ngbrs of this block with content
-               }
+         uint8_t refLevel;
+         vmesh::LocalID indices[3];
+         vmesh.getIndices(velocity_block_with_content_list[block_index],refLevel,indices[0],indices[1],indices[2]);
+         if (indices[0] == invalid_block_index()) continue;
+         for (int d=0; d<3; ++d) {
+            bboxMin[d] = std::min(bboxMin[d],std::max(0,(int)indices[d]-addWidthV));
+            bboxMax[d] = std::max(bboxMax[d],std::min((int)gridLength[d]-1,(int)indices[d]+addWidthV));
+         }
+      }
+      for (std::vector<SpatialCell*>::const_iterator neighbor=spatial_neighbors.begin();
+           neighbor != spatial_neighbors.end(); ++neighbor) {
+         for (vmesh::LocalID block_index=0; block_index<(*neighbor)->velocity_block_with_content_list.size(); ++block_index) {
+            uint8_t refLevel;
+            vmesh::LocalID indices[3];
+            vmesh.getIndices((*neighbor)->velocity_block_with_content_list[block_index],refLevel,indices[0],indices[1],indices[2]);
+            if (indices[0] == invalid_block_index()) continue;
+            for (int d=0; d<3; ++d) {
+               bboxMin[d] = std::min(bboxMin[d],(int)indices[d]);
+               bboxMax[d] = std::max(bboxMax[d],(int)indices[d]);
             }
          }
       }
 
-      //add neighbor content info for spatial space neighbors to map. We loop over
+      int dims[3] = {0,0,0};
+      if (bboxMax[0] >= bboxMin[0]) {
+         for (int d=0; d<3; ++d) dims[d] = bboxMax[d]-bboxMin[d]+1;
+      }
+      // The mask has one extra entry at the end, which absorbs blocks
+      // falling outside of the bounding box
+      const size_t maskSize = (size_t)dims[0]*dims[1]*dims[2];
+      if (neighbors_have_content.size() < maskSize+1) {
+         neighbors_have_content.resize(maskSize+1);
+         dilationBuffer.resize(maskSize+1);
+      }
+      std::fill(neighbors_have_content.begin(),neighbors_have_content.begin()+maskSize,0);
+
+      // Flag blocks with content, then dilate the flags in velocity space
+      // to cover the sparseBlockAddWidthV neighborhood of every such block
+      for (vmesh::LocalID block_index=0; block_index<velocity_block_with_content_list.size(); ++block_index) {
+         neighbors_have_content[blockMaskIndex(vmesh,velocity_block_with_content_list[block_index],bboxMin,dims)] = 1;
+      }
+      if (addWidthV > 0 && maskSize > 0) {
+         dilateBlockMask(neighbors_have_content,dilationBuffer,dims,0,addWidthV);
+         dilateBlockMask(dilationBuffer,neighbors_have_content,dims,1,addWidthV);
+         dilateBlockMask(neighbors_have_content,dilationBuffer,dims,2,addWidthV);
+         neighbors_have_content.swap(dilationBuffer);
+      }
+
+      //add neighbor content info for spatial space neighbors to mask. We loop over
       //neighbor cell lists with existing blocks, and raise the
       //flag for the local block with same block id
       for (std::vector<SpatialCell*>::const_iterator neighbor=spatial_neighbors.begin();
            neighbor != spatial_neighbors.end(); ++neighbor) {
          for (vmesh::LocalID block_index=0; block_index<(*neighbor)->velocity_block_with_content_list.size(); ++block_index) {
-            vmesh::GlobalID block = (*neighbor)->velocity_block_with_content_list[block_index];
-            neighbors_have_content.insert(block);
+            neighbors_have_content[blockMaskIndex(vmesh,(*neighbor)->velocity_block_with_content_list[block_index],bboxMin,dims)] = 1;
          }
       }
 
@@ -166,31 +259,43 @@ namespace spatial_cell {
                exit(1);
             }
             #endif
-            
-            bool removeBlock = false;
-            std::unordered_set<vmesh::GlobalID>::iterator it = neighbors_have_content.find(blockGID);
-            if (it == neighbors_have_content.end()) removeBlock = true;
 
-            if (removeBlock == true) {
-               //No content, and also no neighbor have content -> remove
-               //and increment rho loss counters
-               const Real* block_parameters = get_block_parameters(popID)+blockLID*BlockParams::N_VELOCITY_BLOCK_PARAMS;
-               const Real DV3 = block_parameters[BlockParams::DVX]
-                 * block_parameters[BlockParams::DVY]
-                 * block_parameters[BlockParams::DVZ];
-               Real sum=0;
-               for (unsigned int i=0; i<WID3; ++i) sum += get_data(popID)[blockLID*SIZE_VELBLOCK+i];
-               this->populations[popID].RHOLOSSADJUST += DV3*sum;
-	       
-               // and finally remove block
-               this->remove_velocity_block(blockGID,popID);
-            }
+            const size_t index = blockMaskIndex(vmesh,blockGID,bboxMin,dims);
+            if (index < maskSize && neighbors_have_content[index] != 0) continue;
+
+            //No content, and also no neighbor have content -> remove
+            //and increment rho loss counters
+            const Real* block_parameters = get_block_parameters(popID)+blockLID*BlockParams::N_VELOCITY_BLOCK_PARAMS;
+            const Real DV3 = block_parameters[BlockParams::DVX]
+              * block_parameters[BlockParams::DVY]
+              * block_parameters[BlockParams::DVZ];
+            Real sum=0;
+            for (unsigned int i=0; i<WID3; ++i) sum += get_data(popID)[blockLID*SIZE_VELBLOCK+i];
+            this->populations[popID].RHOLOSSADJUST += DV3*sum;
+
+            // and finally remove block
+            this->remove_velocity_block(blockGID,popID);
          }
       }
 
-      // ADD all blocks with neighbors in spatial or velocity space (if it exists then the block is unchanged)
-      for (std::unordered_set<vmesh::GlobalID>::iterator it=neighbors_have_content.begin(); it != neighbors_have_content.end(); ++it) {
-         this->add_velocity_block(*it,popID);
+      // ADD all blocks with neighbors in spatial or velocity space. Blocks that
+      // already exist are skipped, the rest are added with a single call.
+      blocksToAdd.clear();
+      for (int k=0; k<dims[2]; ++k) for (int j=0; j<dims[1]; ++j) {
+         const uint8_t* line = neighbors_have_content.data() + ((size_t)k*dims[1]+j)*dims[0];
+         for (int i=0; i<dims[0]; ++i) {
+            if (line[i] == 0) continue;
+            const vmesh::GlobalID blockGID = vmesh.getGlobalID(0,bboxMin[0]+i,bboxMin[1]+j,bboxMin[2]+k);
+            if (vmesh.count(blockGID) == 0) blocksToAdd.push_back(blockGID);
+         }
+      }
+      if (blocksToAdd.size() == 0) return;
+
+      if (vmesh.size()+blocksToAdd.size() <= vmesh.getMaxVelocityBlocks()) {
+         add_velocity_blocks(blocksToAdd,popID);
+      } else {
+         // Mesh would overflow, add blocks one at a time until it is full
+         for (size_t b=0; b<blocksToAdd.size(); ++b) this->add_velocity_block(blocksToAdd[b],popID);
       }
    }
 
@@ -630,6 +735,20 @@ namespace spatial_cell {
             block_lengths.push_back(sizeof(Realf) * VELOCITY_BLOCK_LENGTH * populations[activePopID].blockContainer.size());
          }
 
+         if ((SpatialCell::mpi_transfer_type & Transfer::VEL_BLOCK_DATA_PACKED_SIZE) !=0) {
+            //Communicate size of packed data so that buffers can be allocated on receiving side
+            displacements.push_back((uint8_t*) &(this->packed_block_data_size) - (uint8_t*) this);
+            block_lengths.push_back(sizeof(uint64_t));
+         }
+         if ((SpatialCell::mpi_transfer_type & Transfer::VEL_BLOCK_DATA_PACKED) !=0) {
+            //packed_block_data_size should first be updated, before this can be done (PACKED_SIZE)
+            if (receiving) {
+               this->packed_block_data.resize(this->packed_block_data_size);
+            }
+            displacements.push_back((uint8_t*) this->packed_block_data.data() - (uint8_t*) this);
+            block_lengths.push_back(this->packed_block_data_size);
+         }
+
          if ((SpatialCell::mpi_transfer_type & Transfer::NEIGHBOR_VEL_BLOCK_DATA) != 0) {
             /*We are actually transferring the data of a
             * neighbor. The values of neighbor_block_data
@@ -755,11 +874,36 @@ namespace spatial_cell {
          //}
       }
 
+      // Drop empty ranges and merge ranges that are adjacent in memory, e.g.
+      // consecutive entries of parameters, so that short transfers end up
+      // as a single contiguous range.
+      size_t nRanges = 0;
+      for (size_t i = 0; i < displacements.size(); ++i) {
+         if (block_lengths[i] == 0) {
+            continue;
+         }
+         if (nRanges > 0 && displacements[nRanges-1] + block_lengths[nRanges-1] == displacements[i]) {
+            block_lengths[nRanges-1] += block_lengths[i];
+         } else {
+            displacements[nRanges] = displacements[i];
+            block_lengths[nRanges] = block_lengths[i];
+            ++nRanges;
+         }
+      }
+      displacements.resize(nRanges);
+      block_lengths.resize(nRanges);
+
       void* address = this;
       int count;
       MPI_Datatype datatype;
       
-      if (displacements.size() > 0) {
+      if (displacements.size() == 1) {
+         // A single contiguous range needs no derived datatype, which saves
+         // creating, committing and freeing one per cell and transfer.
+         address = (uint8_t*) this + displacements[0];
+         count = block_lengths[0];
+         datatype = MPI_BYTE;
+      } else if (displacements.size() > 0) {
          count = 1;
          MPI_Type_create_hindexed(
             displacements.size(),
@@ -1372,25 +1516,28 @@ namespace spatial_cell {
       populations[popID].max_dt[species::MAXVDT] = value;
    }
 
-   /**  Purges extra capacity from block vectors. It sets size to
-    * num_blocks * block_allocation_factor (if capacity greater than this), 
-    * and also forces capacity to this new smaller value.
+   /**  Purges extra capacity from block vectors. Capacity is shrunk to
+    * num_blocks * block_allocation_factor only after a population has been 
+    * under-used in several consecutive calls, see VelocityBlockContainer::shrink_to_fit.
     * @return True on success.*/
    bool SpatialCell::shrink_to_fit() {
       bool success = true;
+      for (size_t p=0; p<populations.size(); ++p) {
+         if (populations[p].blockContainer.shrink_to_fit() == false) success = false;
+      }
       return success;
+   }
 
+   /** Return the bytes of velocity block data copied by reallocations since
+    * the previous call, and restart counting.*/
+   uint64_t SpatialCell::pop_reallocated_bytes() {
+      uint64_t bytes = blockContainerTemp.getReallocatedBytes();
+      blockContainerTemp.clearReallocatedBytes();
       for (size_t p=0; p<populations.size(); ++p) {
-         const uint64_t amount 
-            = 2 + populations[p].blockContainer.size() 
-            * populations[p].blockContainer.getBlockAllocationFactor();
-         
-         // Allow capacity to be a bit large than needed by number of blocks, shrink otherwise
-         if (populations[p].blockContainer.capacity() > amount ) 
-            if (populations[p].blockContainer.recapacitate(amount) == false) success = false;
-
+         bytes += populations[p].blockContainer.getReallocatedBytes();
+         populations[p].blockContainer.clearReallocatedBytes();
       }
-      return success;
+      return bytes;
    }
 
    /** Update the two lists containing blocks with content, and blocks without content.
@@ -1444,6 +1591,75 @@ namespace spatial_cell {
       return success;
    }
    
+   /** Pack the velocity block data of the given species for MPI transfer. For each 
+    * block a bit mask of its non-zero values is stored, followed by the non-zero values 
+    * of all blocks. This is lossless, and blocks that are empty or contain only a few 
+    * values shrink to little more than their mask. The packed data is transferred with 
+    * Transfer::VEL_BLOCK_DATA_PACKED_SIZE and Transfer::VEL_BLOCK_DATA_PACKED.
+    * @param popID ID of the particle species.*/
+   void SpatialCell::pack_velocity_block_data(const uint popID) {
+      const vmesh::LocalID nBlocks = populations[popID].blockContainer.size();
+      const Realf* data = get_data(popID);
+      const size_t masksSize = sizeof(uint64_t) * PACKED_MASK_WORDS * nBlocks;
+
+      packed_block_data.resize(masksSize + sizeof(Realf) * WID3 * nBlocks);
+      uint64_t* masks = reinterpret_cast<uint64_t*>(packed_block_data.data());
+      Realf* values = reinterpret_cast<Realf*>(packed_block_data.data() + masksSize);
+
+      size_t nValues = 0;
+      for (vmesh::LocalID blockLID=0; blockLID<nBlocks; ++blockLID) {
+         const Realf* blockData = data + blockLID*WID3;
+         uint64_t* blockMasks = masks + blockLID*PACKED_MASK_WORDS;
+         for (uint w=0; w<PACKED_MASK_WORDS; ++w) blockMasks[w] = 0;
+         for (uint i=0; i<WID3; ++i) {
+            if (blockData[i] != 0.0) {
+               blockMasks[i/64] |= (1ull << (i%64));
+               values[nValues++] = blockData[i];
+            }
+         }
+      }
+      packed_block_data_size = masksSize + sizeof(Realf) * nValues;
+   }
+
+   /** Unpack velocity block data of the given species received as packed by 
+    * pack_velocity_block_data. The velocity mesh must already contain the same 
+    * blocks as on the sending process. Does nothing if no packed data was received.
+    * @param popID ID of the particle species.*/
+   void SpatialCell::unpack_velocity_block_data(const uint popID) {
+      if (packed_block_data_size == 0) return;
+
+      const vmesh::LocalID nBlocks = populations[popID].blockContainer.size();
+      Realf* data = get_data(popID);
+      const size_t masksSize = sizeof(uint64_t) * PACKED_MASK_WORDS * nBlocks;
+
+      #ifdef DEBUG_SPATIAL_CELL
+      if (packed_block_data_size < masksSize) {
+         std::cerr << "ERROR: packed data of " << packed_block_data_size << " bytes for " << nBlocks << " blocks " << __FILE__ << ':' << __LINE__ << std::endl;
+         exit(1);
+      }
+      #endif
+
+      const uint64_t* masks = reinterpret_cast<const uint64_t*>(packed_block_data.data());
+      const Realf* values = reinterpret_cast<const Realf*>(packed_block_data.data() + masksSize);
+
+      size_t nValues = 0;
+      for (vmesh::LocalID blockLID=0; blockLID<nBlocks; ++blockLID) {
+         Realf* blockData = data + blockLID*WID3;
+         const uint64_t* blockMasks = masks + blockLID*PACKED_MASK_WORDS;
+         for (uint i=0; i<WID3; ++i) {
+            blockData[i] = ((blockMasks[i/64] >> (i%64)) & 1) ? values[nValues++] : 0.0;
+         }
+      }
+      release_packed_block_data();
+   }
+
+   /** Free the packed velocity block data. Called once the transfer of the packed 
+    * data has completed, as the buffer is sized for the full block data of the cell.*/
+   void SpatialCell::release_packed_block_data() {
+      std::vector<uint8_t>().swap(packed_block_data);
+      packed_block_data_size = 0;
+   }
+
    /** Updates minValue based on algorithm value from parameters (see parameters.cpp).
     * @param popID ID of the particle species.*/
    void SpatialCell::updateSparseMinValue(const uint popID) {
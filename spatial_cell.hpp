@@ -118,6 +118,8 @@ namespace spatial_cell {
       const uint64_t RANDOMGEN                = (1ull<<27);
       const uint64_t CELL_GRADPE_TERM         = (1ull<<28);
       const uint64_t REFINEMENT_PARAMETERS    = (1ull<<29);
+      const uint64_t VEL_BLOCK_DATA_PACKED_SIZE = (1ull<<30);
+      const uint64_t VEL_BLOCK_DATA_PACKED    = (1ull<<31);
       //all data
       const uint64_t ALL_DATA =
       CELL_PARAMETERS
@@ -279,6 +281,7 @@ namespace spatial_cell {
       void merge_values(const uint popID);
       void prepare_to_receive_blocks(const uint popID);
       bool shrink_to_fit();
+      uint64_t pop_reallocated_bytes();
       size_t size(const uint popID) const;
       void remove_velocity_block(const vmesh::GlobalID& block,const uint popID);
       void swap(vmesh::VelocityMesh<vmesh::GlobalID,vmesh::LocalID>& vmesh,
@@ -310,6 +313,9 @@ namespace spatial_cell {
       void set_mpi_transfer_enabled(bool transferEnabled);
       void updateSparseMinValue(const uint popID);
       Real getVelocityBlockMinValue(const uint popID) const;
+      void pack_velocity_block_data(const uint popID);
+      void unpack_velocity_block_data(const uint popID);
+      void release_packed_block_data();
 
       // Random number generator functions
       //char* get_rng_state_buffer();
@@ -341,6 +347,9 @@ namespace spatial_cell {
       std::vector<vmesh::GlobalID> velocity_block_with_content_list;          /**< List of existing cells with content, only up-to-date after
                                                                                * call to update_has_content().*/
       vmesh::LocalID velocity_block_with_content_list_size;                   /**< Size of vector. Needed for MPI communication of size before actual list transfer.*/
+      std::vector<uint8_t> packed_block_data;                                 /**< Velocity block data packed by pack_velocity_block_data, for MPI transfer.*/
+      uint64_t packed_block_data_size;                                        /**< Size of packed_block_data in bytes. Needed for MPI communication of size 
+                                                                               * before actual data transfer. Zero if there is no packed data to unpack.*/
       std::vector<vmesh::GlobalID> velocity_block_with_no_content_list;       /**< List of existing cells with no content, only up-to-date after
                                                                                * call to update_has_content. This is also never transferred
                                                                                * over MPI, so is invalid on remote cells.*/
@@ -737,10 +737,22 @@ namespace SBC {
       const uint popID,
       const bool calculate_V_moments
    ) {
-      phiprof::Timer timer {"vlasovBoundaryCondition (Copysphere)"};
       this->vlasovBoundaryFluffyCopyFromAllCloseNbrs(mpiGrid, cellID, popID, calculate_V_moments, this->speciesParams[popID].fluffiness);
    }
 
+   /**
+    * Times the whole batch instead of starting a timer for every cell.
+    */
+   void Copysphere::vlasovBoundaryConditionBatch(
+      dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+      const std::vector<CellID>& cells,
+      const uint popID,
+      const bool calculate_V_moments
+   ) {
+      phiprof::Timer timer {"vlasovBoundaryCondition (Copysphere)"};
+      SysBoundaryCondition::vlasovBoundaryConditionBatch(mpiGrid, cells, popID, calculate_V_moments);
+   }
+
    /**
     * NOTE: This function must initialize all particle species!
     * @param project
@@ -132,6 +132,12 @@ namespace SBC {
          const uint popID,
          const bool calculate_V_moments
       );
+      virtual void vlasovBoundaryConditionBatch(
+         dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+         const std::vector<CellID>& cells,
+         const uint popID,
+         const bool calculate_V_moments
+      );
       
       void getFaces(bool *faces) override;
       virtual std::string getName() const;
@@ -690,11 +690,7 @@ void SysBoundary::applySysBoundaryVlasovConditions(
       vector<CellID> localCells;
       getBoundaryCellList(mpiGrid, mpiGrid.get_local_cells_not_on_process_boundary(SYSBOUNDARIES_EXTENDED_NEIGHBORHOOD_ID), localCells);
 
-#pragma omp parallel for
-      for (uint i = 0; i < localCells.size(); i++) {
-         cuint sysBoundaryType = mpiGrid[localCells[i]]->sysBoundaryFlag;
-         this->getSysBoundary(sysBoundaryType)->vlasovBoundaryCondition(mpiGrid, localCells[i], popID, calculate_V_moments);
-      }
+      applyVlasovConditionBatches(mpiGrid, localCells, popID, calculate_V_moments);
       if (calculate_V_moments) {
          calculateMoments_V(mpiGrid, localCells, true);
       } else {
@@ -711,11 +707,7 @@ void SysBoundary::applySysBoundaryVlasovConditions(
       vector<CellID> boundaryCells;
       getBoundaryCellList(mpiGrid, mpiGrid.get_local_cells_on_process_boundary(SYSBOUNDARIES_EXTENDED_NEIGHBORHOOD_ID),
                           boundaryCells);
-#pragma omp parallel for
-      for (uint i = 0; i < boundaryCells.size(); i++) {
-         cuint sysBoundaryType = mpiGrid[boundaryCells[i]]->sysBoundaryFlag;
-         this->getSysBoundary(sysBoundaryType)->vlasovBoundaryCondition(mpiGrid, boundaryCells[i], popID, calculate_V_moments);
-      }
+      applyVlasovConditionBatches(mpiGrid, boundaryCells, popID, calculate_V_moments);
       if (calculate_V_moments) {
          calculateMoments_V(mpiGrid, boundaryCells, true);
       } else {
@@ -730,6 +722,23 @@ void SysBoundary::applySysBoundaryVlasovConditions(
    } // for-loop over populations
 }
 
+/*! Sort the given boundary cells by boundary type and apply the Vlasov boundary condition of each type to its cells as one batch.
+ * \param mpiGrid Grid
+ * \param cells Boundary cells, as returned by getBoundaryCellList
+ * \param popID Particle species ID
+ * \param calculate_V_moments if true, compute into _V, false into _R moments
+ */
+void SysBoundary::applyVlasovConditionBatches(dccrg::Dccrg<SpatialCell, dccrg::Cartesian_Geometry>& mpiGrid,
+                                              const vector<CellID>& cells, const uint popID, const bool calculate_V_moments) {
+   map<uint, vector<CellID>> cellsPerType;
+   for (size_t i = 0; i < cells.size(); ++i) {
+      cellsPerType[mpiGrid[cells[i]]->sysBoundaryFlag].push_back(cells[i]);
+   }
+   for (auto& typeCells : cellsPerType) {
+      this->getSysBoundary(typeCells.first)->vlasovBoundaryConditionBatch(mpiGrid, typeCells.second, popID, calculate_V_moments);
+   }
+}
+
 /*! Get a pointer to the SysBoundaryCondition of given index.
  * \param sysBoundaryType Type of the system boundary condition to return
  * \return Pointer to the instance of the SysBoundaryCondition. NULL if sysBoundaryType is invalid.
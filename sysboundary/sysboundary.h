@@ -93,6 +93,8 @@ class SysBoundary {
    private:
       /*! Private copy-constructor to prevent copying the class. */
       SysBoundary(const SysBoundary& bc);
+      void applyVlasovConditionBatches(dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+                                       const std::vector<CellID>& cells, const uint popID, const bool calculate_V_moments);
 
       //std::set<SBC::SysBoundaryCondition*,SBC::Comparator> sysBoundaries;
 
@@ -288,6 +288,24 @@ namespace SBC {
       }
    }
    
+   /*! Default batched Vlasov boundary condition, applies vlasovBoundaryCondition to each cell in parallel.
+    * \param mpiGrid Grid
+    * \param cells Cells of this boundary type.
+    * \param popID Particle species ID.
+    * \param calculate_V_moments if true, compute into _V, false into _R moments
+    */
+   void SysBoundaryCondition::vlasovBoundaryConditionBatch(
+      dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+      const vector<CellID>& cells,
+      const uint popID,
+      const bool calculate_V_moments
+   ) {
+      #pragma omp parallel for schedule(dynamic)
+      for (size_t i=0; i<cells.size(); ++i) {
+         this->vlasovBoundaryCondition(mpiGrid, cells[i], popID, calculate_V_moments);
+      }
+   }
+
    /*! Function used to copy the distribution and moments from (one of) the closest sysboundarytype::NOT_SYSBOUNDARY cell.
     * \param mpiGrid Grid
     * \param cellID The cell's ID.
@@ -363,13 +381,14 @@ namespace SBC {
       //just copy data to existing blocks, no modification of to blocks allowed
       for (vmesh::LocalID blockLID=0; blockLID<to->get_number_of_velocity_blocks(popID); ++blockLID) {
          const vmesh::GlobalID blockGID = to->get_velocity_block_global_id(blockLID,popID);
-//          const Realf* fromBlock_data = from->get_data(from->get_velocity_block_local_id(blockGID) );
+         const vmesh::LocalID fromBlockLID = from->get_velocity_block_local_id(blockGID,popID);
          Realf* toBlock_data = to->get_data(blockLID,popID);
-         if (from->get_velocity_block_local_id(blockGID,popID) == from->invalid_local_id()) {
+         if (fromBlockLID == from->invalid_local_id()) {
             for (unsigned int i = 0; i < VELOCITY_BLOCK_LENGTH; i++) {
                toBlock_data[i] = 0.0; //block did not exist in from cell, fill with zeros.
             }
          } else {
+            const Realf* fromBlock_data = from->get_data(fromBlockLID,popID);
             const Real* blockParameters = to->get_block_parameters(blockLID, popID);
             // check where cells are
             creal vxBlock = blockParameters[BlockParams::VXCRD];
@@ -384,8 +403,7 @@ namespace SBC {
             for (uint kc=0; kc<WID; ++kc) {
                for (uint jc=0; jc<WID; ++jc) {
                   for (uint ic=0; ic<WID; ++ic) {
-                     velocity_cell_indices_t indices = {ic, jc, kc};
-                     const uint cell = from->get_velocity_cell(indices);
+                     const uint cell = cellIndex(ic,jc,kc);
                      
                      creal vxCellCenter = vxBlock + (ic+convert<Real>(0.5))*dvxCell;
                      creal vyCellCenter = vyBlock + (jc+convert<Real>(0.5))*dvyCell;
@@ -393,19 +411,19 @@ namespace SBC {
                      const int vxCellSign = vxCellCenter < 0 ? -1 : 1;
                      const int vyCellSign = vyCellCenter < 0 ? -1 : 1;
                      const int vzCellSign = vzCellCenter < 0 ? -1 : 1;
-                     Realf value = from->get_value(blockGID, cell, popID);
+                     Realf value = fromBlock_data[cell];
                      //loop over spatial cells in quadrant of influence
                      for(int dvx = 0 ; dvx <= 1; dvx++) {
                         for(int dvy = 0 ; dvy <= 1; dvy++) {
                            for(int dvz = 0 ; dvz <= 1; dvz++) {
                               const int flowToId = nbrID(dvx * vxCellSign, dvy * vyCellSign, dvz * vzCellSign);
-                              if(flowtoCells.at(flowToId)){
-                                 value = min(value, flowtoCellsBlockCache.at(flowToId)[cell]);
+                              if(flowtoCells[flowToId]){
+                                 value = min(value, flowtoCellsBlockCache[flowToId][cell]);
                               }
                            }
                         }
                      }
-                     to->set_value(blockGID, cell,  value, popID);
+                     toBlock_data[cell] = value;
                   }
                }
             }
@@ -476,51 +494,61 @@ namespace SBC {
     */
    void averageCellData(
          dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
-         const vector<CellID> cellList,
+         const vector<CellID>& cellList,
          SpatialCell *to,
          const uint popID,
          creal fluffiness /* default =0.0*/
    ) {
       const size_t numberOfCells = cellList.size();
       creal factor = fluffiness / convert<Real>(numberOfCells);
-      
 
-      // Rescale own vspace
-      for (vmesh::LocalID toBlockLID=0; toBlockLID<to->get_number_of_velocity_blocks(popID); ++toBlockLID) {
-         // Pointer to target block data
-         Realf* toData = to->get_data(toBlockLID,popID);
-         
-         // Add values from source cells
-         for (uint kc=0; kc<WID; ++kc) for (uint jc=0; jc<WID; ++jc) for (uint ic=0; ic<WID; ++ic) {
-            toData[cellIndex(ic,jc,kc)] *= 1.0 - fluffiness;
-         }
-         toData += SIZE_VELBLOCK;
-      } // for-loop over velocity blocks
-
-      
+      // Target block of each source block, for all source cells one after another.
+      // Missing target blocks are created here, before any data pointers are
+      // taken, since creating blocks may reallocate the target block data.
+      static thread_local vector<vmesh::LocalID> toBlockLIDs;
+      toBlockLIDs.clear();
       for (size_t i=0; i<numberOfCells; i++) {
          const SpatialCell* incomingCell = mpiGrid[cellList[i]];
-
-         const Realf* fromData = incomingCell->get_data(popID);
          for (vmesh::LocalID incBlockLID=0; incBlockLID<incomingCell->get_number_of_velocity_blocks(popID); ++incBlockLID) {
             // Global ID of the block containing incoming data
-            vmesh::GlobalID incBlockGID = incomingCell->get_velocity_block_global_id(incBlockLID,popID);
-            
+            const vmesh::GlobalID incBlockGID = incomingCell->get_velocity_block_global_id(incBlockLID,popID);
+
             // Get local ID of the target block. If the block doesn't exist, create it.
-            vmesh::GlobalID toBlockLID = to->get_velocity_block_local_id(incBlockGID,popID);
+            vmesh::LocalID toBlockLID = to->get_velocity_block_local_id(incBlockGID,popID);
             if (toBlockLID == SpatialCell::invalid_local_id()) {
                to->add_velocity_block(incBlockGID,popID);
                toBlockLID = to->get_velocity_block_local_id(incBlockGID,popID);
             }
-            
-            // Pointer to target block data
-            Realf* toData = to->get_data(toBlockLID,popID);
+            toBlockLIDs.push_back(toBlockLID);
+         }
+      }
 
-            // Add values from source cells
-            for (uint kc=0; kc<WID; ++kc) for (uint jc=0; jc<WID; ++jc) for (uint ic=0; ic<WID; ++ic) {
-               toData[cellIndex(ic,jc,kc)] += factor*fromData[cellIndex(ic,jc,kc)];
+      // Rescale own vspace, including the blocks created above which are zero
+      Realf* toData = to->get_data(popID);
+      const size_t toDataSize = to->get_number_of_velocity_blocks(popID)*WID3;
+      const Realf ownFactor = 1.0 - fluffiness;
+      #pragma omp simd
+      for (size_t c=0; c<toDataSize; ++c) {
+         toData[c] *= ownFactor;
+      }
+
+      if (factor == 0.0) {
+         return;
+      }
+
+      // Add values from source cells, block by block over contiguous block data
+      const vmesh::LocalID* toLID = toBlockLIDs.data();
+      for (size_t i=0; i<numberOfCells; i++) {
+         const SpatialCell* incomingCell = mpiGrid[cellList[i]];
+         const Realf* fromData = incomingCell->get_data(popID);
+         for (vmesh::LocalID incBlockLID=0; incBlockLID<incomingCell->get_number_of_velocity_blocks(popID); ++incBlockLID) {
+            Realf* toBlockData = toData + (*toLID)*WID3;
+            #pragma omp simd
+            for (uint c=0; c<WID3; ++c) {
+               toBlockData[c] += factor*fromData[c];
             }
             fromData += SIZE_VELBLOCK;
+            ++toLID;
          } // for-loop over velocity blocks
       }
    }
@@ -859,7 +887,6 @@ namespace SBC {
    array<SpatialCell*,27> & SysBoundaryCondition::getFlowtoCells(
       const CellID& cellID
    ) {
-      phiprof::Timer timer {"getFlowtoCells"};
       array<SpatialCell*,27> & flowtoCells = allFlowtoCells.at(cellID);
       return flowtoCells;
    }
@@ -869,7 +896,6 @@ namespace SBC {
       const vmesh::GlobalID blockGID,
       const uint popID
    ) {
-      phiprof::Timer timer {"getFlowtoCellsBlock"};
       array<Realf*,27> flowtoCellsBlock;
       flowtoCellsBlock.fill(NULL);
       for (uint i=0; i<27; i++) {
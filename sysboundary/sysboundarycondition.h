@@ -161,6 +161,21 @@ namespace SBC {
             const bool calculate_V_moments
         )=0;
 
+         /** Compute the Vlasov boundary condition for a batch of cells of this
+          * boundary type. The default implementation calls vlasovBoundaryCondition
+          * for each cell in parallel; boundaries can override it to set up the
+          * work once for the whole batch instead of once per cell.
+          * Must be called outside of an OpenMP parallel region.
+          * @param mpiGrid Parallel grid.
+          * @param cells Local cells whose sysBoundaryFlag is this boundary's index.
+          * @param popID Particle species ID.*/
+         virtual void vlasovBoundaryConditionBatch(
+            dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+            const std::vector<CellID>& cells,
+            const uint popID,
+            const bool calculate_V_moments
+         );
+
          /*! Function used to know which faces the boundary condition is applied to.
           * @param faces Pointer to array of 6 bool in which the values are returned whether the corresponding face is of that
           * type. Order: 0 x+; 1 x-; 2 y+; 3 y-; 4 z+; 5 z-
@@ -321,7 +336,7 @@ namespace SBC {
    // Moved outside the class since it's a helper function that doesn't require member access
    void averageCellData (
       dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
-      std::vector<CellID> cellList,
+      const std::vector<CellID>& cellList,
       SpatialCell *to,
       const uint popID,
       creal fluffiness = 0
@@ -0,0 +1,176 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2016 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <array>
+#include <iomanip>
+#include <vector>
+#include <sys/resource.h>
+
+#include "telemetry.h"
+#include "common.h"
+#include "logger.h"
+#include "parameters.h"
+#include "object_wrapper.h"
+
+using namespace std;
+
+namespace telemetry {
+
+   /*! Metrics reported per process. Phase times and the step time are averages per step
+    *  over the steps since the previous row, the others are sampled when the row is written.
+    */
+   enum Metric {
+      STEP_TIME,
+      TRANSLATION_TIME,
+      ACCELERATION_TIME,
+      FIELD_SOLVER_TIME,
+      LOAD_BALANCE_TIME,
+      IO_TIME,
+      MPI_WAIT_TIME,
+      SPATIAL_CELLS,
+      VELOCITY_BLOCKS,
+      HIGH_WATER_MARK,
+      N_METRICS
+   };
+
+   static const array<string,N_METRICS> metricNames = {
+      "step_s", "translation_s", "acceleration_s", "fieldsolver_s", "loadbalance_s", "io_s", "mpiwait_s",
+      "cells", "blocks", "hwm_GiB"
+   };
+
+   static array<double,N_PHASES> phaseTimes {};
+   static double previousRecordTime {0.0};
+   static uint previousRecordStep {0};
+   static Logger telemetryFile;
+   static bool fileOpen {false};
+   static MPI_Comm nodeComm {MPI_COMM_NULL};
+   static MPI_Comm leaderComm {MPI_COMM_NULL};
+
+   void addTime(const Phase phase, const double seconds) {
+      phaseTimes[phase] += seconds;
+   }
+
+   /*! Open the telemetry file and set up the communicators of the reduction. Collective on MPI_COMM_WORLD.
+    * \param fileName Name of the CSV file
+    * \param append If true, rows are appended to an existing file, e.g. on restart
+    * \return If true, the file was opened successfully
+    */
+   bool open(const string& fileName, const bool append) {
+      int rank, nodeRank;
+      MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+      // Reduce first within each node, then over the node leaders
+      MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodeComm);
+      MPI_Comm_rank(nodeComm, &nodeRank);
+      MPI_Comm_split(MPI_COMM_WORLD, nodeRank == 0 ? 0 : MPI_UNDEFINED, rank, &leaderComm);
+
+      if (telemetryFile.open(MPI_COMM_WORLD, MASTER_RANK, fileName, append) == false) return false;
+      fileOpen = true;
+      if (!append) {
+         telemetryFile << "step,t,dt";
+         for (const auto& name : metricNames) {
+            telemetryFile << "," << name << "_min," << name << "_avg," << name << "_max," << name << "_maxrank";
+         }
+         telemetryFile << endl << write;
+      }
+      previousRecordTime = MPI_Wtime();
+      previousRecordStep = Parameters::tstep;
+      phaseTimes.fill(0.0);
+      return true;
+   }
+
+   /*! Reduce the metrics of all processes and append a row into the telemetry file,
+    *  if io.telemetry_interval steps have passed. Collective on MPI_COMM_WORLD.
+    * \param mpiGrid Spatial grid
+    */
+   void recordStep(dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid) {
+      if (!fileOpen || Parameters::telemetryInterval == 0 || Parameters::tstep % Parameters::telemetryInterval != 0) return;
+
+      int rank, nProcs;
+      MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+      MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
+
+      const double now = MPI_Wtime();
+      const double steps = max(Parameters::tstep - previousRecordStep, 1u);
+      const vector<CellID>& cells = getLocalCells();
+      double blocks = 0.0;
+      for (const auto cellID : cells) {
+         for (uint popID=0; popID<getObjectWrapper().particleSpecies.size(); ++popID) {
+            blocks += mpiGrid[cellID]->get_number_of_velocity_blocks(popID);
+         }
+      }
+      struct rusage usage;
+      getrusage(RUSAGE_SELF, &usage);
+
+      array<double,N_METRICS> local;
+      local[STEP_TIME] = (now - previousRecordTime) / steps;
+      local[TRANSLATION_TIME] = phaseTimes[TRANSLATION] / steps;
+      local[ACCELERATION_TIME] = phaseTimes[ACCELERATION] / steps;
+      local[FIELD_SOLVER_TIME] = phaseTimes[FIELD_SOLVER] / steps;
+      local[LOAD_BALANCE_TIME] = phaseTimes[LOAD_BALANCE] / steps;
+      local[IO_TIME] = phaseTimes[IO] / steps;
+      local[MPI_WAIT_TIME] = phaseTimes[MPI_WAIT] / steps;
+      local[SPATIAL_CELLS] = cells.size();
+      local[VELOCITY_BLOCKS] = blocks;
+      local[HIGH_WATER_MARK] = usage.ru_maxrss * 1024.0 / (1024.0*1024.0*1024.0); // ru_maxrss is in KiB on Linux
+
+      struct {
+         double val;
+         int rank;
+      } localLoc[N_METRICS], nodeMin[N_METRICS], nodeMax[N_METRICS], globalMin[N_METRICS], globalMax[N_METRICS];
+      for (int i=0; i<N_METRICS; ++i) {
+         localLoc[i].val = local[i];
+         localLoc[i].rank = rank;
+      }
+      array<double,N_METRICS> nodeSum, globalSum;
+      MPI_Reduce(localLoc, nodeMin, N_METRICS, MPI_DOUBLE_INT, MPI_MINLOC, 0, nodeComm);
+      MPI_Reduce(localLoc, nodeMax, N_METRICS, MPI_DOUBLE_INT, MPI_MAXLOC, 0, nodeComm);
+      MPI_Reduce(local.data(), nodeSum.data(), N_METRICS, MPI_DOUBLE, MPI_SUM, 0, nodeComm);
+      if (leaderComm != MPI_COMM_NULL) {
+         MPI_Reduce(nodeMin, globalMin, N_METRICS, MPI_DOUBLE_INT, MPI_MINLOC, 0, leaderComm);
+         MPI_Reduce(nodeMax, globalMax, N_METRICS, MPI_DOUBLE_INT, MPI_MAXLOC, 0, leaderComm);
+         MPI_Reduce(nodeSum.data(), globalSum.data(), N_METRICS, MPI_DOUBLE, MPI_SUM, 0, leaderComm);
+      }
+
+      if (rank == MASTER_RANK) {
+         telemetryFile << setprecision(6);
+         telemetryFile << Parameters::tstep << "," << Parameters::t << "," << Parameters::dt;
+         for (int i=0; i<N_METRICS; ++i) {
+            telemetryFile << "," << globalMin[i].val << "," << globalSum[i]/nProcs << "," << globalMax[i].val << "," << globalMax[i].rank;
+         }
+         telemetryFile << endl << write;
+      }
+
+      phaseTimes.fill(0.0);
+      previousRecordStep = Parameters::tstep;
+      // Exclude the time of the reduction above from the next row
+      previousRecordTime = MPI_Wtime();
+   }
+
+   /*! Close the telemetry file and free the communicators. Collective on MPI_COMM_WORLD. */
+   void close() {
+      if (!fileOpen) return;
+      telemetryFile.close();
+      fileOpen = false;
+      if (leaderComm != MPI_COMM_NULL) MPI_Comm_free(&leaderComm);
+      if (nodeComm != MPI_COMM_NULL) MPI_Comm_free(&nodeComm);
+   }
+}
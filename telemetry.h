@@ -0,0 +1,76 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2016 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <string>
+#include <mpi.h>
+
+#include <dccrg.hpp>
+#include <dccrg_cartesian_geometry.hpp>
+
+#include "spatial_cell.hpp"
+
+/*! Lightweight per-step performance telemetry. Wall times of the main solver
+ *  phases and of waiting in MPI are accumulated on each process, and every
+ *  io.telemetry_interval steps their per-step averages, together with cell and
+ *  block counts and the memory high water mark, are reduced over the processes
+ *  and appended as one row into a CSV file that can be followed during the run.
+ */
+namespace telemetry {
+   /*! Phases whose wall time is accumulated. MPI_WAIT overlaps the other phases. */
+   enum Phase {
+      TRANSLATION,
+      ACCELERATION,
+      FIELD_SOLVER,
+      LOAD_BALANCE,
+      IO,
+      MPI_WAIT,
+      N_PHASES
+   };
+
+   void addTime(const Phase phase, const double seconds);
+   bool open(const std::string& fileName, const bool append);
+   void recordStep(dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid);
+   void close();
+
+   /*! Accumulates the wall time from construction to stop() or destruction into a phase.
+    *  Not thread-safe, use outside of OpenMP parallel regions.
+    */
+   class PhaseTimer {
+    public:
+      PhaseTimer(const Phase phase) : phase {phase}, startTime {MPI_Wtime()}, running {true} {}
+      ~PhaseTimer() {stop();}
+      void stop() {
+         if (running) {
+            addTime(phase, MPI_Wtime() - startTime);
+            running = false;
+         }
+      }
+    private:
+      const Phase phase;
+      const double startTime;
+      bool running;
+   };
+}
+
+#endif
@@ -53,6 +53,8 @@
 #include <typeinfo>
 #include <algorithm>
 #include <cstring>
+#include <numeric>
+#include <vector>
 
 #include "definitions.h"
 #include <vlsv_reader.h>
@@ -79,6 +81,72 @@ enum gridType{
    ionosphere
 };
 
+/*! Values of one variable component, stored in contiguous arrays sorted by
+ * cell ID (dccrg cell ID, fsgrid global index or ionosphere node index).
+ * Lookups are binary searches, and statistics and distances loop over flat arrays.
+ */
+struct OrderedData {
+   vector<uint64_t> ids;       /*!< Cell IDs in ascending order.*/
+   vector<Real> values;        /*!< Variable value of each cell.*/
+   vector<uint64_t> fileOrder; /*!< Position of each cell in the VARIABLE array of the file.*/
+
+   size_t size() const {
+      return ids.size();
+   }
+
+   void clear() {
+      ids.clear();
+      values.clear();
+      fileOrder.clear();
+   }
+
+   void reserve(const size_t n) {
+      ids.reserve(n);
+      values.reserve(n);
+      fileOrder.reserve(n);
+   }
+
+   /*! Append a cell in file order. Call sort() once all cells have been added.*/
+   void push_back(const uint64_t id,const Real value) {
+      fileOrder.push_back(ids.size());
+      ids.push_back(id);
+      values.push_back(value);
+   }
+
+   /*! Sort the cells by ID. Of repeated IDs only the first one read is kept.*/
+   void sort() {
+      if (adjacent_find(ids.begin(),ids.end(),greater_equal<uint64_t>()) == ids.end()) {
+         return;
+      }
+
+      vector<size_t> permutation(ids.size());
+      iota(permutation.begin(),permutation.end(),0);
+      stable_sort(permutation.begin(),permutation.end(),[this](const size_t a,const size_t b) {
+         return ids[a] < ids[b];
+      });
+
+      OrderedData sorted;
+      sorted.reserve(ids.size());
+      for (size_t i=0; i<permutation.size(); ++i) {
+         const size_t j = permutation[i];
+         if (sorted.size() > 0 && sorted.ids.back() == ids[j]) continue;
+         sorted.ids.push_back(ids[j]);
+         sorted.values.push_back(values[j]);
+         sorted.fileOrder.push_back(fileOrder[j]);
+      }
+      ids.swap(sorted.ids);
+      values.swap(sorted.values);
+      fileOrder.swap(sorted.fileOrder);
+   }
+
+   /*! Index of the given cell, or size() if the cell does not exist.*/
+   size_t find(const uint64_t id) const {
+      vector<uint64_t>::const_iterator it = lower_bound(ids.begin(),ids.end(),id);
+      if (it == ids.end() || *it != id) return ids.size();
+      return it - ids.begin();
+   }
+};
+
 
 static uint64_t convUInt(const char* ptr, const vlsv::datatype::type& dataType, const uint64_t& dataSize) {
    if (dataType != vlsv::datatype::type::UINT) {
@@ -169,7 +237,7 @@ bool copyArray(vlsv::Reader& input,vlsv::Writer& output,
 /* Small function that overrides how fsgrid diff files are written*/
 bool HandleFsGrid(const string& inputFileName,
                   vlsv::Writer& output,
-                  std::map<uint, Real> orderedData)
+                  const OrderedData& orderedData)
 {
    
 
@@ -226,11 +294,8 @@ bool HandleFsGrid(const string& inputFileName,
    patch["zperiodic"]=zperiodic;
 
 
-   //Get the global IDs in a vector
-   std::vector<uint64_t> globalIds;
-   for (const auto iter : orderedData){
-      globalIds.push_back( iter.first   );
-   }
+   //The global IDs are already stored sorted in a vector
+   const std::vector<uint64_t>& globalIds = orderedData.ids;
    
    //Write to file
    output.writeArray("MESH",patch,arraysize,1,&globalIds[0]);
@@ -377,7 +442,7 @@ bool getFsgridDecomposition(vlsvinterface::Reader& file, std::array<int,3>& deco
  * @param output VLSV reader for the file where the cloned mesh is written.
  * @param meshName Name of the mesh.
  * @return If true, the mesh was successfully cloned.*/
-bool cloneMesh(const string& inputFileName,vlsv::Writer& output,const string& meshName, std::map<uint, Real> orderedData) {
+bool cloneMesh(const string& inputFileName,vlsv::Writer& output,const string& meshName, const OrderedData& orderedData) {
    bool success = true;
             
    vlsv::Reader input;
@@ -424,15 +489,13 @@ bool cloneMesh(const string& inputFileName,vlsv::Writer& output,const string& me
  * \param meshName Address of the string containing the name of the mesh to be extracted
  * \param varToExtract Pointer to the char array containing the name of the variable to extract
  * \param compToExtract Unsigned int designating the component to extract (0 for scalars)
- * \param orderedData Pointer to the return argument map which will get the extracted dataset
+ * \param orderedData Pointer to the return argument which will get the extracted dataset
  */
 bool convertMesh(vlsvinterface::Reader& vlsvReader,
                  const string& meshName,
                  const char * varToExtract,
                  const uint compToExtract,
-                 map<uint, Real> * orderedData,
-                 unordered_map<size_t,size_t>& cellOrder,
-                 const bool& storeCellOrder) {
+                 OrderedData * orderedData) {
 
    //Check for null pointer:
    if( !varToExtract || !orderedData ) {
@@ -460,14 +523,8 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
    switch(gridName) {
       case gridType::SpatialGrid:
          {
-            std::vector<char> variableBuffer(variableVectorSize * variableDataSize);
-            float *variablePtrFloat = reinterpret_cast<float *>(variableBuffer.data());
-            double *variablePtrDouble = reinterpret_cast<double *>(variableBuffer.data());
-            uint *variablePtrUint = reinterpret_cast<uint *>(variableBuffer.data());
-            int *variablePtrInt = reinterpret_cast<int *>(variableBuffer.data());
-
-            // Read the mesh array one node (of a spatial cell) at a time
-            // and create a map which contains each cell's CellID and variable to be extracted
+            // Read the whole variable array in one go and pick out each
+            // cell's CellID and the component to be extracted
             //Get local cell ids:
             vector<uint64_t> local_cells;
             if ( vlsvReader.getCellIds( local_cells, meshName) == false ) {
@@ -484,22 +541,23 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
                abort();
             }
 
-            if (storeCellOrder == true) {
-               cellOrder.clear();
+            std::vector<char> variableBuffer(variableArraySize * variableVectorSize * variableDataSize);
+            if (vlsvReader.readArray("VARIABLE", variableAttributes, 0, variableArraySize, variableBuffer.data()) == false) {
+               cerr << "ERROR, failed to read variable '" << _varToExtract << "' at " << __FILE__ << " " << __LINE__ << endl;
+               variableSuccess = false;
+               break;
             }
 
+            const uint64_t numberOfCells = min<uint64_t>(local_cells.size(), variableArraySize);
             orderedData->clear();
+            orderedData->reserve(numberOfCells);
 
-            for (uint64_t i=0; i<local_cells.size(); ++i) {
-               const short int amountToReadIn = 1;
-               const uint64_t & startingReadIndex = i;
-               if (vlsvReader.readArray("VARIABLE", variableAttributes, startingReadIndex, amountToReadIn, variableBuffer.data()) == false) {
-                  cerr << "ERROR, failed to read variable '" << _varToExtract << "' at " << __FILE__ << " " << __LINE__ << endl;
-                  variableSuccess = false; 
-                  break;
-               }
-               // Get the CellID
-               uint64_t & CellID = local_cells[i];
+            for (uint64_t i=0; i<numberOfCells; ++i) {
+               const char* cellData = variableBuffer.data() + i * variableVectorSize * variableDataSize;
+               const float *variablePtrFloat = reinterpret_cast<const float *>(cellData);
+               const double *variablePtrDouble = reinterpret_cast<const double *>(cellData);
+               const uint *variablePtrUint = reinterpret_cast<const uint *>(cellData);
+               const int *variablePtrInt = reinterpret_cast<const int *>(cellData);
 
                // Get the variable value
                Real extract = NAN;
@@ -519,12 +577,9 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
                      cerr << "ERROR, BAD DATATYPE AT " << __FILE__ << " " << __LINE__ << endl;
                      break;
                }
-               // Put those into the map
-               orderedData->insert(pair<uint64_t, Real>(CellID, extract));
-               if (storeCellOrder == true) {
-                  cellOrder[CellID] = i;
-               }
+               orderedData->push_back(local_cells[i], extract);
             }
+            orderedData->sort();
          }
          break;
  
@@ -635,8 +690,7 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
                               cerr << "ERROR, BAD DATATYPE AT " << __FILE__ << " " << __LINE__ << endl;
                               break;
                         }
-                        //Add to map
-                        orderedData->insert(pair<uint64_t, Real>(globalindex, data));
+                        orderedData->push_back(globalindex, data);
                         counter+=variableVectorSize;
                      }
                   }
@@ -644,6 +698,7 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
                readOffset+=readSize;
 
             }
+            orderedData->sort();
          }
          break;
 
@@ -668,7 +723,7 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
                      }
 
                      for(unsigned int i=0; i<variableArraySize; i++) {
-                        orderedData->insert(pair<uint64_t, Real>(i, buffer[i*variableVectorSize + compToExtract]));
+                        orderedData->push_back(i, buffer[i*variableVectorSize + compToExtract]);
                      }
                   } else if(variableDataSize == sizeof(float)) {
                      std::vector<double> buffer(variableVectorSize * variableArraySize);
@@ -680,7 +735,7 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
                      }
 
                      for(unsigned int i=0; i<variableArraySize; i++) {
-                        orderedData->insert(pair<uint64_t, Real>(i, buffer[i*variableVectorSize + compToExtract]));
+                        orderedData->push_back(i, buffer[i*variableVectorSize + compToExtract]);
                      }
                   }
                }
@@ -709,16 +764,14 @@ bool convertMesh(vlsvinterface::Reader& vlsvReader,
  * \param fileName String containing the name of the file to be processed
  * \param varToExtract Pointer to the char array containing the name of the variable to extract
  * \param compToExtract Unsigned int designating the component to extract (0 for scalars)
- * \param orderedData Pointer to the return argument map which will get the extracted dataset
+ * \param orderedData Pointer to the return argument which will get the extracted dataset
  * \sa convertMesh
  */
 template <class T>
 bool convertSILO(const string fileName,
                  const char * varToExtract,
                  const uint compToExtract,
-                 map<uint, Real> * orderedData,
-                 unordered_map<size_t,size_t>& cellOrder,
-                 const bool& storeCellOrder=false) {
+                 OrderedData * orderedData) {
    bool success = true;
 
    // Open VLSV file for reading:
@@ -743,7 +796,7 @@ bool convertSILO(const string fileName,
    for (list<string>::const_iterator it=meshNames.begin(); it!=meshNames.end(); ++it) {
       if (*it != attributes["--meshname"]) continue;
 
-      if (convertMesh(vlsvReader, *it, varToExtract, compToExtract, orderedData, cellOrder, storeCellOrder) == false) {
+      if (convertMesh(vlsvReader, *it, varToExtract, compToExtract, orderedData) == false) {
          return false;
       }      
    }
@@ -751,38 +804,83 @@ bool convertSILO(const string fileName,
    return success;
 }
 
+/*! Look up the values of the second dataset at the cells of the first one. The
+ * cell lists of the two files are normally identical, in which case the values
+ * are simply copied, otherwise each cell is found by binary search.
+ * \param orderedData1 Reference dataset
+ * \param orderedData2 Dataset to be matched to the reference
+ * \param values2 Return argument, value of orderedData2 at each cell of orderedData1
+ * \param found Return argument, nonzero if the cell of orderedData1 exists in orderedData2
+ */
+void alignData(const OrderedData& orderedData1,
+               const OrderedData& orderedData2,
+               vector<Real>& values2,
+               vector<uint8_t>& found
+              ) {
+   if (orderedData1.ids == orderedData2.ids) {
+      values2 = orderedData2.values;
+      found.assign(orderedData1.size(), 1);
+      return;
+   }
+
+   values2.assign(orderedData1.size(), 0.0);
+   found.assign(orderedData1.size(), 0);
+   #pragma omp parallel for schedule(static)
+   for (size_t i=0; i<orderedData1.size(); ++i) {
+      const size_t j = orderedData2.find(orderedData1.ids[i]);
+      if (j < orderedData2.size()) {
+         values2[i] = orderedData2.values[j];
+         found[i] = 1;
+      }
+   }
+}
+
 /*! Shift the second file to the average of the first
- * \param orderedData1 Pointer to the reference file's data
- * \param orderedData2 Pointer to the data to be shifted
- * \param shiftedData2 Pointer to where the shifted data of the second file will be put
+ * \param orderedData1 Reference file's data
+ * \param orderedData2 Data to be shifted
+ * \param values2 Values of orderedData2 at the cells of orderedData1, from alignData
+ * \param shiftedValues2 Return argument, values2 shifted to the average of the first file
+ * \sa alignData
  */
-bool shiftAverage(const map<uint, Real>* const orderedData1,
-                  const map<uint, Real>* const orderedData2,
-                  map<uint,Real>* shiftedData2
+bool shiftAverage(const OrderedData& orderedData1,
+                  const OrderedData& orderedData2,
+                  const vector<Real>& values2,
+                  vector<Real>& shiftedValues2
                  ) {
-   map<uint, Real>::const_iterator it1, it2;
    Real avg1 = 0.0;
    Real avg2 = 0.0;
    
-   for(it1=orderedData1->begin(), it2=orderedData2->begin();
-       it1 != orderedData1->end(), it2 != orderedData2->end();
-       it1++, it2++)
-   {
-      avg1 += orderedData1->at(it1->first);
-      avg2 += orderedData2->at(it2->first);
+   #pragma omp parallel for schedule(static) reduction(+:avg1)
+   for (size_t i=0; i<orderedData1.size(); ++i) {
+      avg1 += orderedData1.values[i];
    }
-   avg1 /= orderedData1->size();
-   avg2 /= orderedData1->size();
+   #pragma omp parallel for schedule(static) reduction(+:avg2)
+   for (size_t i=0; i<orderedData2.size(); ++i) {
+      avg2 += orderedData2.values[i];
+   }
+   avg1 /= orderedData1.size();
+   avg2 /= orderedData1.size();
    
-   for(it2=orderedData2->begin(); it2 != orderedData2->end(); it2++)
-   {
-      shiftedData2->insert(pair<uint, Real>(it2->first, it2->second - avg2 + avg1));
+   shiftedValues2.resize(values2.size());
+   #pragma omp parallel for schedule(static)
+   for (size_t i=0; i<values2.size(); ++i) {
+      shiftedValues2[i] = values2[i] - avg2 + avg1;
    }
    
    return 0;
 }
 
-/*! Compute the absolute and relative \f$ p \f$-distance between two datasets X(x) provided in the maps orderedData1 and orderedData2. Note that the dataset passed in orderedData1 will be taken as the reference dataset both when shifting averages and when computing relative distances.
+/*! Position of the i:th cell of the dataset in the difference array written to the diff file.
+ * SpatialGrid data is written in the cell order of the file, fsgrid and ionosphere data by index.
+ */
+static inline size_t diffArrayIndex(const OrderedData& orderedData,const size_t i) {
+   if (gridName == gridType::SpatialGrid) {
+      return orderedData.fileOrder[i];
+   }
+   return orderedData.ids[i];
+}
+
+/*! Compute the absolute and relative \f$ p \f$-distance between two datasets X(x) provided in orderedData1 and values2. Note that the dataset passed in orderedData1 will be taken as the reference dataset both when shifting averages and when computing relative distances.
  * 
  * For \f$ p \neq 0 \f$:
  * 
@@ -804,93 +902,71 @@ bool shiftAverage(const map<uint, Real>* const orderedData1,
  * 
  * \f$ \|X_1 - X_2\|_\infty = \max_i\left(|X_1(i) - X_2(i)|\right) / \|X_1\|_\infty \f$
  * 
- * \param orderedData1 Pointer to the first file's data map
- * \param orderedData2 Pointer to the second file's data map
+ * \param orderedData1 The first file's data
+ * \param values2 The second file's data at the cells of orderedData1, average-shifted if wished
+ * \param found Nonzero for the cells of orderedData1 that exist in the second file
  * \param p Parameter of the distance formula
  * \param absolute Return argument pointer, absolute value
  * \param relative Return argument pointer, relative value
- * \param doShiftAverage Boolean argument to determine whether to shift the second file's data
- * \sa shiftAverage
+ * \sa alignData shiftAverage
  */
-bool pDistance(const map<uint, Real>& orderedData1,
-               const map<uint, Real>& orderedData2,
+bool pDistance(const OrderedData& orderedData1,
+               const vector<Real>& values2,
+               const vector<uint8_t>& found,
                creal p,
                Real * absolute,
                Real * relative,
-               const bool doShiftAverage,
-               const unordered_map<size_t,size_t>& cellOrder,
                vlsv::Writer& outputFile,
                const std::string& meshName,
                const std::string& varName
               ) {
-   map<uint,Real> shiftedData2;
-   map<uint,Real>* data2 = const_cast< map<uint,Real>* >(&orderedData2);   
-
-   if (doShiftAverage == true) {
-      shiftAverage(&orderedData1,&orderedData2,&shiftedData2);
-      data2 = &shiftedData2;
-   }
+   const vector<Real>& values1 = orderedData1.values;
 
    // Reset old values
-   *absolute = 0.0;
-   *relative = 0.0;
+   Real distance = 0.0;
+   Real length = 0.0;
 
    vector<Real> array(orderedData1.size());
    for (size_t i=0; i<array.size(); ++i) array[i] = -1.0;
 
-   Real length = 0.0;
    if (p == 0) {
-      for (map<uint,Real>::const_iterator it1=orderedData1.begin(); it1!=orderedData1.end(); ++it1) {
-         map<uint,Real>::const_iterator it2 = data2->find(it1->first);
+      #pragma omp parallel for schedule(static) reduction(max:distance,length)
+      for (size_t i=0; i<values1.size(); ++i) {
          Real value = 0.0;
-         if (it2 != data2->end()) {
-            value = abs(it1->second - it2->second);
-            *absolute = max(*absolute, value);
-            length    = max(length, abs(it1->second));
-         
-            }
-         if (gridName==gridType::SpatialGrid){  
-            array[cellOrder.at(it1->first)] = value;
-         }else if (gridName==gridType::fsgrid || gridName==gridType::ionosphere) {   
-            array.at(it1->first)=value;
-         }  
+         if (found[i]) {
+            value = abs(values1[i] - values2[i]);
+            distance = max(distance, value);
+            length   = max(length, abs(values1[i]));
+         }
+         array[diffArrayIndex(orderedData1, i)] = value;
       }
    } else if (p == 1) {
-      for (map<uint,Real>::const_iterator it1=orderedData1.begin(); it1!=orderedData1.end(); ++it1) {
-         map<uint,Real>::const_iterator it2 = data2->find(it1->first);
+      #pragma omp parallel for schedule(static) reduction(+:distance,length)
+      for (size_t i=0; i<values1.size(); ++i) {
          Real value = 0.0;
-         if (it2 != data2->end()) {
-            value = abs(it1->second - it2->second);
-            *absolute += value;
-            length    += abs(it1->second);
-         
-            }
-         if (gridName==gridType::SpatialGrid){  
-            array[cellOrder.at(it1->first)] = value;
-         }else if (gridName==gridType::fsgrid || gridName==gridType::ionosphere) {   
-            array[it1->first]=value;
-         }  
+         if (found[i]) {
+            value = abs(values1[i] - values2[i]);
+            distance += value;
+            length   += abs(values1[i]);
+         }
+         array[diffArrayIndex(orderedData1, i)] = value;
       }
    } else {
-      for (map<uint,Real>::const_iterator it1=orderedData1.begin(); it1!=orderedData1.end(); ++it1) {
-         map<uint,Real>::const_iterator it2 = data2->find(it1->first);
+      #pragma omp parallel for schedule(static) reduction(+:distance,length)
+      for (size_t i=0; i<values1.size(); ++i) {
          Real value = 0.0;
-         if (it2 != data2->end()) {
-            value = pow(abs(it1->second - it2->second), p);
-            *absolute += value;
-            length    += pow(abs(it1->second), p);
-         
-            }
-         if (gridName==gridType::SpatialGrid){  
-            array[cellOrder.at(it1->first)] = pow(value,1.0/p);
-         }else if (gridName==gridType::fsgrid || gridName==gridType::ionosphere) {   
-            array[it1->first]=pow(value,1.0/p);
-         }  
+         if (found[i]) {
+            value = pow(abs(values1[i] - values2[i]), p);
+            distance += value;
+            length   += pow(abs(values1[i]), p);
+         }
+         array[diffArrayIndex(orderedData1, i)] = pow(value,1.0/p);
       }
-      *absolute = pow(*absolute, 1.0 / p);
+      distance = pow(distance, 1.0 / p);
       length = pow(length, 1.0 / p);
    }
 
+   *absolute = distance;
    if (length != 0.0) *relative = *absolute / length;
    else {
       cout << "WARNING (pDistance) : length of reference is 0.0, cannot divide to give relative distance." << endl;
@@ -961,13 +1037,14 @@ bool outputDistance(const Real p,
 }
 
 /*! Compute statistics on a single file
+ * \param orderedData Pointer to the dataset
  * \param size Return argument pointer, dataset size
  * \param mini Return argument pointer, dataset minimum
  * \param maxi Return argument pointer, dataset maximum
  * \param avg Return argument pointer, dataset average
  * \param stdev Return argument pointer, dataset standard deviation
  */
-bool singleStatistics(map<uint, Real> * orderedData,
+bool singleStatistics(const OrderedData * orderedData,
                       Real * size,
                       Real * mini,
                       Real * maxi,
@@ -976,28 +1053,31 @@ bool singleStatistics(map<uint, Real> * orderedData,
 )
 {
    /*
-    * Returns basic statistics on the map passed to it.
+    * Returns basic statistics on the dataset passed to it.
     */
-   map<uint, Real>::const_iterator it;
-   
-   *size = orderedData->size();
-   *mini = numeric_limits<Real>::max();
-   *maxi = numeric_limits<Real>::min();
-   *avg = 0.0;
-   *stdev = 0.0;
+   const vector<Real>& values = orderedData->values;
+   Real minimum = numeric_limits<Real>::max();
+   Real maximum = numeric_limits<Real>::min();
+   Real sum = 0.0;
    
-   for(it=orderedData->begin(); it != orderedData->end() ; it++)
-   {
-      *mini = min(*mini, orderedData->at(it->first));
-      *maxi = max(*maxi, orderedData->at(it->first));
-      *avg += orderedData->at(it->first);
-   }
-   *avg /= *size;
-   for(it=orderedData->begin(); it != orderedData->end() ; it++)
-   {
-      *stdev += pow(orderedData->at(it->first) - *avg, 2.0);
-   }
-   *stdev = sqrt(*stdev);
+   #pragma omp parallel for schedule(static) reduction(min:minimum) reduction(max:maximum) reduction(+:sum)
+   for (size_t i=0; i<values.size(); ++i) {
+      minimum = min(minimum, values[i]);
+      maximum = max(maximum, values[i]);
+      sum += values[i];
+   }
+   *size = values.size();
+   *mini = minimum;
+   *maxi = maximum;
+   *avg = sum / *size;
+
+   const Real average = *avg;
+   Real sumOfSquares = 0.0;
+   #pragma omp parallel for schedule(static) reduction(+:sumOfSquares)
+   for (size_t i=0; i<values.size(); ++i) {
+      sumOfSquares += (values[i] - average) * (values[i] - average);
+   }
+   *stdev = sqrt(sumOfSquares);
    *stdev /= (*size - 1);
    return 0;
 }
@@ -1103,58 +1183,6 @@ bool printNonVerboseData()
    return 0;
 }
 
-bool getBlockIds(vlsvinterface::Reader& vlsvReader,
-                 const unordered_map<uint64_t, pair<uint64_t, uint32_t>> & cellsWithBlocksLocations,
-                 const uint64_t & cellId,
-                 vector<uint32_t> & blockIds ) {
-   // Read the block ids:
-   //Check if the cell id can be found:
-   unordered_map<uint64_t, pair<uint64_t, uint32_t>>::const_iterator it = cellsWithBlocksLocations.find( cellId );
-   if( it == cellsWithBlocksLocations.end() ) {
-      cerr << "COULDNT FIND CELL ID " << cellId << " AT " << __FILE__ << " " << __LINE__ << endl;
-      return false;
-   }
-   //Get offset and number of blocks:
-   pair<uint64_t, uint32_t> offsetAndBlocks = it->second;
-   const uint64_t blockOffset = get<0>(offsetAndBlocks);
-   const uint32_t N_blocks = get<1>(offsetAndBlocks);
-
-   // Get some required info from VLSV file:
-   list<pair<string, string> > attribs;
-   attribs.push_back(make_pair("mesh", attributes["--meshname"]));
-
-   //READ BLOCK IDS:
-   uint64_t blockIds_arraySize, blockIds_vectorSize, blockIds_dataSize;
-   vlsv::datatype::type blockIds_dataType;
-   //Input blockIds_arraySize, blockIds_vectorSize, blockIds_dataSize blockIds_dataType: (Returns false if fails)
-   if (vlsvReader.getArrayInfo("BLOCKIDS", attribs, blockIds_arraySize, blockIds_vectorSize, blockIds_dataType, blockIds_dataSize) == false) {
-      cerr << "ERROR, COULD NOT FIND BLOCKIDS AT " << __FILE__ << " " << __LINE__ << endl;
-      return false;
-   }
-   //Make sure blockid's datatype is correct:
-   if( blockIds_dataType != vlsv::datatype::type::UINT ) {
-      cerr << "ERROR, bad datatype at " << __FILE__ << " " << __LINE__ << endl;
-      return false;
-   }
-   //Create buffer for reading in data:  (Note: arraySize, vectorSize, etc were fetched from getArrayInfo)
-   char * blockIds_buffer = new char[N_blocks*blockIds_vectorSize*blockIds_dataSize];
-   //Read the data into the buffer:
-   if( vlsvReader.readArray( "BLOCKIDS", attribs, blockOffset, N_blocks, blockIds_buffer ) == false ) {
-      cerr << "ERROR, FAILED TO READ BLOCKIDS AT " << __FILE__ << " " << __LINE__ << endl;
-      delete[] blockIds_buffer;
-      return false;
-   }
-   //Input the block ids:
-   blockIds.reserve(N_blocks);
-   for (uint64_t i = 0; i < N_blocks; ++i) {
-      const uint64_t blockId = convUInt(blockIds_buffer + i*blockIds_dataSize, blockIds_dataType, blockIds_dataSize);
-      blockIds.push_back( (uint32_t)(blockId) );
-   }
-   delete[] blockIds_buffer;
-   return true;
-
-}
-
 uint32_t getBlockId( const double vx,
                      const double vy,
                      const double vz,
@@ -1178,32 +1206,53 @@ uint32_t getBlockId( const double vx,
     return blockId;
 }
 
-// Reads avgs values of some given cell id
+/*! Layout of the velocity block arrays of one file. Looked up once per file
+ * so that reading a cell's blocks does not go through the XML footer again.
+ */
+struct BlockArrayInfo {
+   list<pair<string, string> > blockIdAttribs;
+   list<pair<string, string> > avgsAttribs;
+   vlsv::datatype::type blockIdDataType;
+   uint64_t blockIdDataSize;
+   uint64_t avgsDataSize;
+};
+
+/*! Velocity blocks of one spatial cell, sorted by block id.*/
+struct CellBlocks {
+   vector<uint32_t> blockIds;
+   vector<double> avgs;       /*!< 64 values per block, in the order of blockIds.*/
+};
+
+// Looks up the BLOCKIDS and BLOCKVARIABLE arrays of the given population
 // Input:
 // [0] vlsvReader -- Some vlsv reader with a file open
-// [1] cellId -- The spatial cell's ID
+// [1] name -- Name of the population ("proton", or "avgs" in old files)
 // Output:
-// [2] avgs -- Saves the output into an unordered map with block id as the key and an array of avgs as the value
-// return false or true depending on whether the operation was successful
+// [2] info -- Attributes, data types and data sizes of the arrays
+// return false or true depending on whether the arrays were found
 template <class T>
-bool readAvgs( T & vlsvReader,
-               string name,
-               const unordered_map<uint64_t, pair<uint64_t, uint32_t>> & cellsWithBlocksLocations,
-               const uint64_t & cellId, 
-               unordered_map<uint32_t, array<double, 64> > & avgs ) {
-   // Get the block ids:
-   vector<uint32_t> blockIds;
-   if( getBlockIds( vlsvReader, cellsWithBlocksLocations, cellId, blockIds ) == false ) { return false; }
-   // Read avgs:
-   list<pair<string, string> > attribs;
-   attribs.push_back(make_pair("name", name));
-   attribs.push_back(make_pair("mesh", attributes["--meshname"]));
+bool getBlockArrayInfo( T & vlsvReader,
+                        const string & name,
+                        BlockArrayInfo & info ) {
+   uint64_t arraySize, vectorSize;
+
+   info.blockIdAttribs.clear();
+   info.blockIdAttribs.push_back(make_pair("mesh", attributes["--meshname"]));
+   if (vlsvReader.getArrayInfo("BLOCKIDS", info.blockIdAttribs, arraySize, vectorSize, info.blockIdDataType, info.blockIdDataSize) == false) {
+      cerr << "ERROR, COULD NOT FIND BLOCKIDS AT " << __FILE__ << " " << __LINE__ << endl;
+      return false;
+   }
+   //Make sure blockid's datatype is correct:
+   if( info.blockIdDataType != vlsv::datatype::type::UINT ) {
+      cerr << "ERROR, bad datatype at " << __FILE__ << " " << __LINE__ << endl;
+      return false;
+   }
 
+   info.avgsAttribs.clear();
+   info.avgsAttribs.push_back(make_pair("name", name));
+   info.avgsAttribs.push_back(make_pair("mesh", attributes["--meshname"]));
    datatype::type dataType;
-   uint64_t arraySize, vectorSize, dataSize;
-   if (vlsvReader.getArrayInfo("BLOCKVARIABLE", attribs, arraySize, vectorSize, dataType, dataSize) == false) {
-      //no 
-//      cerr << "ERROR READING BLOCKVARIABLE AT " << __FILE__ << " " << __LINE__ << endl;
+   if (vlsvReader.getArrayInfo("BLOCKVARIABLE", info.avgsAttribs, arraySize, vectorSize, dataType, info.avgsDataSize) == false) {
       return false;
    }
 
@@ -1212,55 +1261,64 @@ bool readAvgs( T & vlsvReader,
       cerr << "ERROR, BAD AVGS VECTOR SIZE AT " << __FILE__ << " " << __LINE__ << endl;
       return false;
    }
-   unordered_map<uint64_t, pair<uint64_t, uint32_t>>::const_iterator it = cellsWithBlocksLocations.find( cellId );
-   if( it == cellsWithBlocksLocations.end() ) {
-      cerr << "COULDNT FIND CELL ID " << cellId << " AT " << __FILE__ << " " << __LINE__ << endl;
+   if( info.avgsDataSize != sizeof(float) && info.avgsDataSize != sizeof(double) ) {
+      cerr << "ERROR, BAD AVGS DATASIZE AT " << __FILE__ << " " << __LINE__ << endl;
       return false;
    }
-   //Get offset and number of blocks:
-   pair<uint64_t, uint32_t> offsetAndBlocks = it->second;
+   return true;
+}
+
+// Reads the block ids and avgs values of one spatial cell
+// Input:
+// [0] vlsvReader -- Some vlsv reader with a file open
+// [1] info -- Block array layout from getBlockArrayInfo
+// [2] offsetAndBlocks -- Offset of the cell's first block and number of blocks, from getCellsWithBlocksLocations
+// [3] buffer -- Scratch buffer for the raw file data, reused between cells
+// Output:
+// [4] blocks -- The cell's blocks, sorted by block id
+// return false or true depending on whether the operation was successful
+template <class T>
+bool readCellBlocks( T & vlsvReader,
+                     const BlockArrayInfo & info,
+                     const pair<uint64_t, uint32_t> & offsetAndBlocks,
+                     vector<char> & buffer,
+                     CellBlocks & blocks ) {
+   const uint velocityCellsPerBlock = 64;
    const uint64_t blockOffset = get<0>(offsetAndBlocks);
    const uint32_t N_blocks = get<1>(offsetAndBlocks);
 
-   if( N_blocks != blockIds.size() ) {
-      cerr << "ERROR, BAD AVGS ARRAY SIZE AT " << __FILE__ << " " << __LINE__ << endl;
-      cerr << "AVGS SIZE: " << N_blocks << endl;
-      cerr << "BLOCKIDS SIZE: " << blockIds.size() << endl;
+   // Block ids, in file order
+   buffer.resize(max(N_blocks * info.blockIdDataSize, N_blocks * velocityCellsPerBlock * info.avgsDataSize));
+   if( vlsvReader.readArray( "BLOCKIDS", info.blockIdAttribs, blockOffset, N_blocks, buffer.data() ) == false ) {
+      cerr << "ERROR, FAILED TO READ BLOCKIDS AT " << __FILE__ << " " << __LINE__ << endl;
       return false;
    }
+   vector<pair<uint32_t, uint32_t> > order(N_blocks);
+   for (uint32_t b = 0; b < N_blocks; ++b) {
+      const uint64_t blockId = convUInt(buffer.data() + b*info.blockIdDataSize, info.blockIdDataType, info.blockIdDataSize);
+      order[b] = make_pair((uint32_t)(blockId), b);
+   }
+   sort(order.begin(), order.end());
 
-   char* buffer = new char[N_blocks * vectorSize * dataSize];
-   if (vlsvReader.readArray("BLOCKVARIABLE", attribs, blockOffset, N_blocks, buffer) == false) {
+   // Avgs, stored in block id order
+   if (vlsvReader.readArray("BLOCKVARIABLE", info.avgsAttribs, blockOffset, N_blocks, buffer.data()) == false) {
       cerr << "ERROR could not read block variable at " << __FILE__ << " " << __LINE__ << endl;
-      delete[] buffer;
       return false;
    }
-   // Input avgs values:
-   array<double, 64> avgs_temp;
-   if( dataSize == 4 ) {
-      float * buffer_float = reinterpret_cast<float*>( buffer );
-      for( uint b = 0; b < blockIds.size(); ++b ) {
-         const uint32_t & blockId = blockIds[b];
-         for( uint i = 0; i < vectorSize; ++i ) {
-            avgs_temp[i] = buffer_float[vectorSize * b + i];
-         }
-         avgs.insert(make_pair(blockId, avgs_temp));
-      }
-   } else if( dataSize == 8 ) {
-      double * buffer_double = reinterpret_cast<double*>( buffer );
-      for( uint b = 0; b < blockIds.size(); ++b ) {
-         const uint32_t & blockId = blockIds[b];
-         for( uint i = 0; i < vectorSize; ++i ) {
-            avgs_temp[i] = buffer_double[vectorSize * b + i];
-         }
-         avgs.insert(make_pair(blockId, avgs_temp));
+   blocks.blockIds.resize(N_blocks);
+   blocks.avgs.resize(N_blocks * velocityCellsPerBlock);
+   const float * buffer_float = reinterpret_cast<const float*>( buffer.data() );
+   const double * buffer_double = reinterpret_cast<const double*>( buffer.data() );
+   for( uint32_t b = 0; b < N_blocks; ++b ) {
+      blocks.blockIds[b] = order[b].first;
+      const uint64_t source = (uint64_t)(order[b].second) * velocityCellsPerBlock;
+      double * target = blocks.avgs.data() + (uint64_t)(b) * velocityCellsPerBlock;
+      if( info.avgsDataSize == sizeof(float) ) {
+         for( uint i = 0; i < velocityCellsPerBlock; ++i ) target[i] = buffer_float[source + i];
+      } else {
+         for( uint i = 0; i < velocityCellsPerBlock; ++i ) target[i] = buffer_double[source + i];
       }
-   } else {
-      cerr << "ERROR, BAD AVGS DATASIZE AT " << __FILE__ << " " << __LINE__ << endl;
-      delete[] buffer;
-      return false;
    }
-   delete[] buffer;
    return true;
 }
 
@@ -1388,9 +1446,23 @@ bool compareAvgs( const string fileName1,
       return false;
    }
 
+   // Look up the block arrays once per file (the population is "avgs" in old files)
+   BlockArrayInfo blockInfo1, blockInfo2;
+   if( getBlockArrayInfo( vlsvReader1, "proton", blockInfo1 ) == false ) {
+      if( getBlockArrayInfo( vlsvReader1, "avgs", blockInfo1 ) == false ) {
+         cerr << "ERROR, FAILED TO READ AVGS AT " << __FILE__ << " " << __LINE__ << endl;
+         return false;
+      }
+   }
+   if( getBlockArrayInfo( vlsvReader2, "proton", blockInfo2 ) == false ) {
+      if( getBlockArrayInfo( vlsvReader2, "avgs", blockInfo2 ) == false ) {
+         cerr << "ERROR, FAILED TO READ AVGS AT " << __FILE__ << " " << __LINE__ << endl;
+         return false;
+      }
+   }
+
    // Create a few variables for the cell id loop:
-   vector< double > avgsDiffs;
-   double totalAbsAvgs = 0;
+   double maxDiff = 0;
    double totalAbsDiff = 0;
    double totalAbsLog10Diff = 0;
    double threshold=1e-16;
@@ -1398,12 +1470,19 @@ bool compareAvgs( const string fileName1,
    uint64_t numOfIdenticalBlocks = 0;
    uint64_t numOfNonIdenticalBlocks = 0;
    if( cellIds1[0] == 0 || cellIds2[0] == 0 ) {
-      // User input 0 as the cell id -- compare all cell ids
+      // User input 0 as the cell id -- compare all cell ids, in the order they
+      // are stored in the first file so that it is read through sequentially
+      vector<pair<uint64_t, uint64_t> > cellsByOffset;
+      cellsByOffset.reserve(cellsWithBlocksLocations1.size());
+      for( unordered_map<uint64_t, pair<uint64_t, uint32_t>>::const_iterator it = cellsWithBlocksLocations1.begin(); it != cellsWithBlocksLocations1.end(); ++it ) {
+         cellsByOffset.push_back(make_pair(get<0>(it->second), it->first));
+      }
+      sort(cellsByOffset.begin(), cellsByOffset.end());
       cellIds1.clear();
       cellIds2.clear();
-      for( unordered_map<uint64_t, pair<uint64_t, uint32_t>>::const_iterator it = cellsWithBlocksLocations1.begin(); it != cellsWithBlocksLocations1.end(); ++it ) {
-         cellIds1.push_back(it->first);
-         cellIds2.push_back(it->first);
+      for( size_t c = 0; c < cellsByOffset.size(); ++c ) {
+         cellIds1.push_back(cellsByOffset[c].second);
+         cellIds2.push_back(cellsByOffset[c].second);
       }
    }
 
@@ -1411,167 +1490,66 @@ bool compareAvgs( const string fileName1,
       cerr << "ERROR, BAD CELL ID SIZES AT " << __FILE__ << " " << __LINE__ << endl;
       return false;
    }
-   // Go through cell ids:
+
+   const uint velocityCellsPerBlock = 64;
+   const array<double, velocityCellsPerBlock> zeroAvgs {};
+   vector<char> readBuffer;
+   CellBlocks blocks1, blocks2;
+   // Indices of matching blocks in blocks1 and blocks2, -1 for a block that only one of the cells has
+   vector<pair<int64_t, int64_t> > blockPairs;
+
+   // Go through cell ids, streaming one cell of each file at a time:
    for( uint cellIndex = 0; cellIndex < cellIds2.size(); cellIndex++ ) {
-      const uint64_t & cellId1 = cellIds1[cellIndex];
-      const uint64_t & cellId2 = cellIds2[cellIndex];
-      // Get the avgs in a hash map (The velocity block id is the key and avgs is the value):
-      const uint velocityCellsPerBlock = 64;
-      unordered_map<uint32_t, array<double, velocityCellsPerBlock> > avgs1;
-      unordered_map<uint32_t, array<double, velocityCellsPerBlock> > avgs2;
-      // Store the avgs in avgs1 and 2:
-      if( readAvgs( vlsvReader1, "proton", cellsWithBlocksLocations1, cellId1, avgs1 ) == false ) {
-         if( readAvgs( vlsvReader1, "avgs", cellsWithBlocksLocations1, cellId1, avgs1 ) == false ) {
-            cerr << "ERROR, FAILED TO READ AVGS AT " << __FILE__ << " " << __LINE__ << endl;
-            return false;
-         }
-      }
-      
-      if( readAvgs( vlsvReader2, "proton", cellsWithBlocksLocations2, cellId2, avgs2 ) == false ) {
-         if( readAvgs( vlsvReader2, "avgs", cellsWithBlocksLocations2, cellId2, avgs2 ) == false ) {
-            cerr << "ERROR, FAILED TO READ AVGS AT " << __FILE__ << " " << __LINE__ << endl;
-            return false;
-         }
-      }
-   
-      //Compare the avgs values:
-      // First make a check on how many of the block ids are identical:
-      const size_t sizeOfAvgs1 = avgs1.size();
-      const size_t sizeOfAvgs2 = avgs2.size();
-      // Vector of block ids that are the same
-      vector<uint32_t> blockIds1;
-      vector<uint32_t> blockIds2;
-      blockIds1.reserve(sizeOfAvgs1);
-      blockIds2.reserve(sizeOfAvgs2);
-      // Input block ids:
-      for( unordered_map<uint32_t, array<double, velocityCellsPerBlock> >::const_iterator it = avgs1.begin(); it != avgs1.end(); ++it ) {
-         blockIds1.push_back(it->first);
+      unordered_map<uint64_t, pair<uint64_t, uint32_t>>::const_iterator location1 = cellsWithBlocksLocations1.find( cellIds1[cellIndex] );
+      unordered_map<uint64_t, pair<uint64_t, uint32_t>>::const_iterator location2 = cellsWithBlocksLocations2.find( cellIds2[cellIndex] );
+      if( location1 == cellsWithBlocksLocations1.end() || location2 == cellsWithBlocksLocations2.end() ) {
+         cerr << "COULDNT FIND CELL ID " << cellIds1[cellIndex] << " AT " << __FILE__ << " " << __LINE__ << endl;
+         cerr << "ERROR, FAILED TO READ AVGS AT " << __FILE__ << " " << __LINE__ << endl;
+         return false;
       }
-      for( unordered_map<uint32_t, array<double, velocityCellsPerBlock> >::const_iterator it = avgs2.begin(); it != avgs2.end(); ++it ) {
-         blockIds2.push_back(it->first);
+      if( readCellBlocks( vlsvReader1, blockInfo1, location1->second, readBuffer, blocks1 ) == false
+          || readCellBlocks( vlsvReader2, blockInfo2, location2->second, readBuffer, blocks2 ) == false ) {
+         cerr << "ERROR, FAILED TO READ AVGS AT " << __FILE__ << " " << __LINE__ << endl;
+         return false;
       }
-      // Compare block ids:
-      // Sort
-      sort( blockIds1.begin(), blockIds1.end() );
-      sort( blockIds2.begin(), blockIds2.end() );
-      // Create iterators
-      vector<uint32_t>::const_iterator it1 = blockIds1.begin();
-      vector<uint32_t>::const_iterator it2 = blockIds2.begin();
-      // Separate block ids into two categories -- the ones that blockids1 and blockids2 share and ones that only one of them shares
-      vector<uint32_t> identicalBlockIds;
-      vector<uint32_t> nonIdenticalBlockIds;
-   
-      while( true ) {
-         if( it1 == blockIds1.end() || it2 == blockIds2.end() ) {
-            // Reach end of block ids
-            break;
-         }
-         if( *it1 == *it2 ) {
-            // Identical block id
-            identicalBlockIds.push_back(*it1);
-            it1++; it2++;
-         } else if( *it1 < *it2 ) {
-            // Non identical block id
-            // The block ids are sorted so to get identical block ids one must increment the lower value
-            nonIdenticalBlockIds.push_back(*it1);
-            it1++;
-         } else if( *it2 < *it1 ) {
-            // Non identical block id
-            // The block ids are sorted so to get identical block ids one must increment the lower value
-            nonIdenticalBlockIds.push_back(*it2);
-            it2++;
+
+      // Merge the sorted block id lists into the blocks that both cells share and ones that only one of them has
+      blockPairs.clear();
+      size_t b1 = 0, b2 = 0;
+      while( b1 < blocks1.blockIds.size() || b2 < blocks2.blockIds.size() ) {
+         if( b2 == blocks2.blockIds.size() || (b1 < blocks1.blockIds.size() && blocks1.blockIds[b1] < blocks2.blockIds[b2]) ) {
+            blockPairs.push_back(make_pair((int64_t)(b1), (int64_t)(-1)));
+            ++b1;
+            ++numOfNonIdenticalBlocks;
+         } else if( b1 == blocks1.blockIds.size() || blocks2.blockIds[b2] < blocks1.blockIds[b1] ) {
+            blockPairs.push_back(make_pair((int64_t)(-1), (int64_t)(b2)));
+            ++b2;
+            ++numOfNonIdenticalBlocks;
+         } else {
+            blockPairs.push_back(make_pair((int64_t)(b1), (int64_t)(b2)));
+            ++b1; ++b2;
+            ++numOfIdenticalBlocks;
          }
       }
-      // Get the rest of the non identical block ids (If there are any)
-      // Note: This is only needed if for example it1 hit the end of the iteration and it2 still isn't at the end
-      for( ; it1 != blockIds1.end(); ++it1 ) {
-         nonIdenticalBlockIds.push_back(*it1);
-      }
-      for( ; it2 != blockIds2.end(); ++it2 ) {
-         nonIdenticalBlockIds.push_back(*it2);
-      }
-      // Compare block ids:
-      const uint64_t totalNumberOfBlocks = identicalBlockIds.size() + nonIdenticalBlockIds.size();
-      const double percentageOfIdenticalBlocks = (double)(totalNumberOfBlocks) / (double)(identicalBlockIds.size());
-      // Compare the avgs values of the identical blocks:
-      avgsDiffs.reserve(avgsDiffs.size() + identicalBlockIds.size() * velocityCellsPerBlock);
-      for( vector<uint32_t>::const_iterator it = identicalBlockIds.begin(); it != identicalBlockIds.end(); ++it ) {
-         // Get the block id
-         const uint32_t blockId = *it;
-         // Get avgs values:
-         const array<double, velocityCellsPerBlock> & avgsValues1 = avgs1.at(blockId);
-         const array<double, velocityCellsPerBlock> & avgsValues2 = avgs2.at(blockId);
-         // Get the diff:
+
+      // Compare the avgs values, a missing block counts as zeros:
+      #pragma omp parallel for schedule(static) reduction(+:totalAbsDiff,totalAbsLog10Diff,numOfRelevantCells) reduction(max:maxDiff)
+      for( size_t b = 0; b < blockPairs.size(); ++b ) {
+         const double * avgsValues1 = blockPairs[b].first < 0 ? zeroAvgs.data() : blocks1.avgs.data() + blockPairs[b].first * velocityCellsPerBlock;
+         const double * avgsValues2 = blockPairs[b].second < 0 ? zeroAvgs.data() : blocks2.avgs.data() + blockPairs[b].second * velocityCellsPerBlock;
          for( uint i = 0; i < velocityCellsPerBlock; ++i ) {
             double val1=avgsValues1[i]>threshold?avgsValues1[i]:threshold;
             double val2=avgsValues2[i]>threshold?avgsValues2[i]:threshold;
             if(avgsValues1[i]>threshold || avgsValues2[i]>threshold)
                numOfRelevantCells++;
-            
-            avgsDiffs.push_back( abs(val1 - val2) );
-            totalAbsAvgs += (abs(val1) + abs(val2));
-            totalAbsDiff +=  abs(val1 - val2);
-            totalAbsLog10Diff += abs(log10(val1) - log10(val2));
-            
-         }
-      }
-      // Compare the avgs values of nonidentical blocks:
-      array<double, velocityCellsPerBlock> zeroAvgs;
-      for( uint i = 0; i < velocityCellsPerBlock; ++i ) {
-         zeroAvgs[i] = 0;
-      }
-      for( vector<uint32_t>::const_iterator it = nonIdenticalBlockIds.begin(); it != nonIdenticalBlockIds.end(); ++it ) {
-         // Get the block id
-         const uint32_t blockId = *it;
-         // Get avgs values: 
-
-         const array<double, velocityCellsPerBlock> * avgsValues1;
-         const array<double, velocityCellsPerBlock> * avgsValues2;
-
-         unordered_map<uint32_t, array<double, velocityCellsPerBlock> >::const_iterator it2 = avgs1.find( blockId );
-         if( it2 == avgs1.end() ) {
-            avgsValues1 = &zeroAvgs;
-         } else {
-            avgsValues1 = &(it2->second);
-         }
 
-         it2 = avgs2.find( blockId );
-         if( it2 == avgs2.end() ) {
-            avgsValues2 = &zeroAvgs;
-         } else {
-            avgsValues2 = &(it2->second);
-         }
-         // Get the diff:
-         for( uint i = 0; i < velocityCellsPerBlock; ++i ) {
-            double val1=avgsValues1->operator[](i)>threshold?avgsValues1->operator[](i):threshold;
-            double val2=avgsValues2->operator[](i)>threshold?avgsValues2->operator[](i):threshold;
-            if( avgsValues1->operator[](i)>threshold || avgsValues2->operator[](i)>threshold)
-               numOfRelevantCells++;
-            
-            avgsDiffs.push_back( abs(val1 - val2) );
-            totalAbsAvgs += (abs(val1) + abs(val2));
+            maxDiff = max(maxDiff, abs(val1 - val2));
             totalAbsDiff +=  abs(val1 - val2);
             totalAbsLog10Diff += abs(log10(val1) - log10(val2));
          }
       }
-      numOfIdenticalBlocks += identicalBlockIds.size();
-      numOfNonIdenticalBlocks += nonIdenticalBlockIds.size();
-   }
-   // Get the max and min diff, and the sum of the diff
-   double maxDiff = 0;
-   double minDiff = numeric_limits<Real>::max();
-   double sumDiff = 0;
-   for( vector<double>::const_iterator it = avgsDiffs.begin(); it != avgsDiffs.end(); ++it ) {
-      sumDiff += *it;
-      if( maxDiff < *it ) {
-         maxDiff = *it;
-      }
-      if( minDiff > *it ) {
-         minDiff = *it;
-      }
    }
-   
-   const double relativeSumDiff = sumDiff / totalAbsAvgs;
+
    cout << "File names: " << fileName1 << " & " << fileName2 << endl <<
       "NonIdenticalBlocks:      " << numOfNonIdenticalBlocks << endl <<
       "IdenticalBlocks:         " << numOfIdenticalBlocks <<  endl <<
@@ -1600,8 +1578,8 @@ bool process2Files(const string fileName1,
                    const bool verboseOutput,
                    const uint compToExtract2 = 0
                   ) {
-   map<uint, Real> orderedData1;
-   map<uint, Real> orderedData2;
+   OrderedData orderedData1;
+   OrderedData orderedData2;
    Real absolute, relative, mini, maxi, size, avg, stdev;
 
    // If the user wants to check avgs, call the avgs check function and return it. Otherwise move on to compare variables:
@@ -1615,17 +1593,15 @@ bool process2Files(const string fileName1,
       // Compare files:
       if( compareAvgs<vlsvinterface::Reader, vlsvinterface::Reader>(fileName1, fileName2, verboseOutput, cellIds1, cellIds2) == false ) { return false; }
    } else {
-      unordered_map<size_t,size_t> cellOrder;
-   
       bool success = true;
-      success = convertSILO<vlsvinterface::Reader>(fileName1, varToExtract, compToExtract, &orderedData1, cellOrder, true);
+      success = convertSILO<vlsvinterface::Reader>(fileName1, varToExtract, compToExtract, &orderedData1);
 
       if( success == false ) {
          cerr << "ERROR Data import error with " << fileName1 << endl;
          return 1;
       }
 
-      success = convertSILO<vlsvinterface::Reader>(fileName2, varToExtract, compToExtract, &orderedData2, cellOrder, false);
+      success = convertSILO<vlsvinterface::Reader>(fileName2, varToExtract, compToExtract, &orderedData2);
 
       if( success == false ) {
          cerr << "ERROR Data import error with " << fileName2 << endl;
@@ -1672,19 +1648,27 @@ bool process2Files(const string fileName1,
       singleStatistics(&orderedData2, &size, &mini, &maxi, &avg, &stdev);
       outputStats(&size, &mini, &maxi, &avg, &stdev, verboseOutput, false);
 
-      pDistance(orderedData1, orderedData2, 0, &absolute, &relative, false, cellOrder,outputFile,attributes["--meshname"],"d0_"+varName);
+      // Match the cells of the second file to the first one only once, the
+      // average-shifted values are likewise shared by all distances below
+      vector<Real> values2;
+      vector<uint8_t> found;
+      alignData(orderedData1, orderedData2, values2, found);
+      vector<Real> shiftedValues2;
+      shiftAverage(orderedData1, orderedData2, values2, shiftedValues2);
+
+      pDistance(orderedData1, values2, found, 0, &absolute, &relative, outputFile,attributes["--meshname"],"d0_"+varName);
       outputDistance(0, &absolute, &relative, false, verboseOutput, false);
-      pDistance(orderedData1, orderedData2, 0, &absolute, &relative, true, cellOrder,outputFile,attributes["--meshname"],"d0_sft_"+varName);
+      pDistance(orderedData1, shiftedValues2, found, 0, &absolute, &relative, outputFile,attributes["--meshname"],"d0_sft_"+varName);
       outputDistance(0, &absolute, &relative, true, verboseOutput, false);
 
-      pDistance(orderedData1, orderedData2, 1, &absolute, &relative, false, cellOrder,outputFile,attributes["--meshname"],"d1_"+varName);
+      pDistance(orderedData1, values2, found, 1, &absolute, &relative, outputFile,attributes["--meshname"],"d1_"+varName);
       outputDistance(1, &absolute, &relative, false, verboseOutput, false);
-      pDistance(orderedData1, orderedData2, 1, &absolute, &relative, true, cellOrder,outputFile,attributes["--meshname"],"d1_sft_"+varName);
+      pDistance(orderedData1, shiftedValues2, found, 1, &absolute, &relative, outputFile,attributes["--meshname"],"d1_sft_"+varName);
       outputDistance(1, &absolute, &relative, true, verboseOutput, false);
 
-      pDistance(orderedData1, orderedData2, 2, &absolute, &relative, false, cellOrder,outputFile,attributes["--meshname"],"d2_"+varName);
+      pDistance(orderedData1, values2, found, 2, &absolute, &relative, outputFile,attributes["--meshname"],"d2_"+varName);
       outputDistance(2, &absolute, &relative, false, verboseOutput, false);
-      pDistance(orderedData1, orderedData2, 2, &absolute, &relative, true, cellOrder,outputFile,attributes["--meshname"],"d2_sft_"+varName);
+      pDistance(orderedData1, shiftedValues2, found, 2, &absolute, &relative, outputFile,attributes["--meshname"],"d2_sft_"+varName);
       outputDistance(2, &absolute, &relative, true, verboseOutput, false);
 
       outputFile.close();
@@ -24,6 +24,7 @@
 #define VELOCITY_BLOCK_CONTAINER_H
 
 #include <vector>
+#include <utility>
 
 #include "common.h"
 #include "unistd.h"
@@ -34,7 +35,10 @@
 
 namespace vmesh {
 
-   static const double BLOCK_ALLOCATION_FACTOR = 1.1;
+   static const double BLOCK_ALLOCATION_FACTOR = 1.1;     /**< Capacity per block left after shrinking.*/
+   static const double BLOCK_GROWTH_FACTOR = 1.5;         /**< Capacity per block allocated when growing.*/
+   static const double BLOCK_SHRINK_THRESHOLD = 2.0;      /**< Capacity per block above which the container counts as under-used.*/
+   static const unsigned int BLOCK_SHRINK_PATIENCE = 3;   /**< Consecutive under-used shrink_to_fit calls before capacity is released.*/
 
    template<typename LID>
    class VelocityBlockContainer {
@@ -44,8 +48,10 @@ namespace vmesh {
       LID capacity() const;
       size_t capacityInBytes() const;
       void clear();
+      void clearReallocatedBytes();
       void copy(const LID& source,const LID& target);
       static double getBlockAllocationFactor();
+      size_t getReallocatedBytes() const;
       Realf* getData();
       const Realf* getData() const;
       Realf* getData(const LID& blockLID);
@@ -60,6 +66,7 @@ namespace vmesh {
       LID push_back(const uint32_t& N_blocks);
       bool recapacitate(const LID& capacity);
       bool setSize(const LID& newSize);
+      bool shrink_to_fit();
       LID size() const;
       size_t sizeInBytes() const;
       void swap(VelocityBlockContainer& vbc);
@@ -73,16 +80,19 @@ namespace vmesh {
     private:
       void exitInvalidLocalID(const LID& localID,const std::string& funcName) const;
       void resize();
+      void reserve(const LID& newCapacity);
       
       std::vector<Realf,aligned_allocator<Realf,WID3> > block_data;
       Realf null_block_data[WID3];
       LID currentCapacity;
       LID numberOfBlocks;
       std::vector<Real,aligned_allocator<Real,BlockParams::N_VELOCITY_BLOCK_PARAMS> > parameters;
+      unsigned int underusedCount;   /**< Number of consecutive under-used shrink_to_fit calls.*/
+      size_t reallocatedBytes;       /**< Bytes of block data copied by reallocations since last clearReallocatedBytes.*/
    };
    
    template<typename LID> inline
-   VelocityBlockContainer<LID>::VelocityBlockContainer() : currentCapacity {0}, numberOfBlocks {0} {}
+   VelocityBlockContainer<LID>::VelocityBlockContainer() : currentCapacity {0}, numberOfBlocks {0}, underusedCount {0}, reallocatedBytes {0} {}
    
    template<typename LID> inline
    LID VelocityBlockContainer<LID>::capacity() const {
@@ -106,6 +116,12 @@ namespace vmesh {
       
       currentCapacity = 0;
       numberOfBlocks = 0;
+      underusedCount = 0;
+   }
+
+   template<typename LID> inline
+   void VelocityBlockContainer<LID>::clearReallocatedBytes() {
+      reallocatedBytes = 0;
    }
 
    template<typename LID> inline
@@ -155,6 +171,13 @@ namespace vmesh {
    double VelocityBlockContainer<LID>::getBlockAllocationFactor() {
       return BLOCK_ALLOCATION_FACTOR;
    }
+
+   /** Return the number of bytes of existing block data copied to new storage
+    * by reallocations since the last call to clearReallocatedBytes.*/
+   template<typename LID> inline
+   size_t VelocityBlockContainer<LID>::getReallocatedBytes() const {
+      return reallocatedBytes;
+   }
    
    template<typename LID> inline
    Realf* VelocityBlockContainer<LID>::getData() {
@@ -275,17 +298,30 @@ namespace vmesh {
          for (size_t i=0; i<numberOfBlocks*BlockParams::N_VELOCITY_BLOCK_PARAMS; ++i) dummy_parameters[i] = parameters[i];
          dummy_parameters.swap(parameters);
       }
+      reallocatedBytes += numberOfBlocks*(WID3*sizeof(Realf) + BlockParams::N_VELOCITY_BLOCK_PARAMS*sizeof(Real));
       currentCapacity = newCapacity;
+      underusedCount = 0;
       return true;
    }
 
+   /** Reserve storage for exactly newCapacity blocks, so that growth
+    * follows BLOCK_GROWTH_FACTOR instead of the policy of std::vector.*/
+   template<typename LID> inline
+   void VelocityBlockContainer<LID>::reserve(const LID& newCapacity) {
+      if (newCapacity*WID3 <= block_data.capacity()) return;
+      reallocatedBytes += block_data.size()*sizeof(Realf) + parameters.size()*sizeof(Real);
+      block_data.reserve(newCapacity*WID3);
+      parameters.reserve(newCapacity*BlockParams::N_VELOCITY_BLOCK_PARAMS);
+   }
+
    template<typename LID> inline
    void VelocityBlockContainer<LID>::resize() {
       if ((numberOfBlocks+1) >= currentCapacity) {
-         // Resize so that free space is block_allocation_chunk blocks, 
-         // and at least two in case of having zero blocks.
+         // Resize so that free space is (BLOCK_GROWTH_FACTOR-1) times the 
+         // number of blocks, and at least two in case of having zero blocks.
          // The order of velocity blocks is unaltered.
-         currentCapacity = 2 + numberOfBlocks * BLOCK_ALLOCATION_FACTOR;
+         currentCapacity = 2 + numberOfBlocks * BLOCK_GROWTH_FACTOR;
+         reserve(currentCapacity);
          block_data.resize(currentCapacity*WID3);
          parameters.resize(currentCapacity*BlockParams::N_VELOCITY_BLOCK_PARAMS);
       }
@@ -298,6 +334,21 @@ namespace vmesh {
       return true;
    }
 
+   /** Release excess capacity, but only after the container has been under-used
+    * in BLOCK_SHRINK_PATIENCE consecutive calls. Cells whose block count 
+    * oscillates thus keep their storage instead of reallocating it repeatedly.
+    * @return False if the capacity could not be changed.*/
+   template<typename LID> inline
+   bool VelocityBlockContainer<LID>::shrink_to_fit() {
+      const LID amount = 2 + numberOfBlocks * BLOCK_ALLOCATION_FACTOR;
+      if (currentCapacity <= 2 + numberOfBlocks * BLOCK_SHRINK_THRESHOLD) {
+         underusedCount = 0;
+         return true;
+      }
+      if (++underusedCount < BLOCK_SHRINK_PATIENCE) return true;
+      return recapacitate(amount);
+   }
+
    /** Return the number of existing velocity blocks.
     * @return Number of existing velocity blocks.*/
    template<typename LID> inline
@@ -322,6 +373,9 @@ namespace vmesh {
       dummy = numberOfBlocks;
       numberOfBlocks = vbc.numberOfBlocks;
       vbc.numberOfBlocks = dummy;
+
+      std::swap(underusedCount,vbc.underusedCount);
+      std::swap(reallocatedBytes,vbc.reallocatedBytes);
    }
    
    #ifdef DEBUG_VBC
@@ -34,6 +34,7 @@
 #include <fsgrid.hpp>
 
 #include "vlasovmover.h"
+#include "vlasovsolver/vec.h"
 #include "definitions.h"
 #include "mpiconversion.h"
 #include "logger.h"
@@ -48,6 +49,7 @@
 #include "projects/project.h"
 #include "grid.h"
 #include "iowrite.h"
+#include "telemetry.h"
 #include "ioread.h"
 
 #include "object_wrapper.h"
@@ -82,16 +84,6 @@ bool globalflags::ionosphereJustSolved = false;
 
 ObjectWrapper objectWrapper;
 
-void addTimedBarrier(string name){
-#ifdef NDEBUG
-//let's not do a barrier
-   return;
-#endif
-   phiprof::Timer btimer {name, {"Barriers", "MPI"}};
-   MPI_Barrier(MPI_COMM_WORLD);
-}
-
-
 /*! Report spatial cell counts per refinement level as well as velocity cell counts per population into logfile
  */
 void report_cell_and_block_counts(dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid){
@@ -125,8 +117,29 @@ void report_cell_and_block_counts(dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::
       }
       logFile << "] ";
    }
-   logFile << endl << flush;
+   logFile << endl;
 
+   // Velocity block data copied by container reallocations, averaged over the steps since the previous report.
+   // Remote cells are included as their storage is resized on every block list update.
+   static uint previousReportStep = P::tstep;
+   const vector<CellID>& remoteCells = mpiGrid.get_remote_cells_on_process_boundary(FULL_NEIGHBORHOOD_ID);
+   double reallocatedBytes = 0.0;
+   for (const auto cellid : localCells) {
+      reallocatedBytes += mpiGrid[cellid]->pop_reallocated_bytes();
+   }
+   for (const auto cellid : remoteCells) {
+      if (mpiGrid[cellid] != nullptr) {
+         reallocatedBytes += mpiGrid[cellid]->pop_reallocated_bytes();
+      }
+   }
+   const double steps = std::max(P::tstep - previousReportStep, 1u);
+   previousReportStep = P::tstep;
+   reallocatedBytes /= steps;
+   double sumReallocatedBytes, maxReallocatedBytes;
+   MPI_Reduce(&reallocatedBytes, &sumReallocatedBytes, 1, MPI_DOUBLE, MPI_SUM, MASTER_RANK, MPI_COMM_WORLD);
+   MPI_Reduce(&reallocatedBytes, &maxReallocatedBytes, 1, MPI_DOUBLE, MPI_MAX, MASTER_RANK, MPI_COMM_WORLD);
+   logFile << "(CELLS) tstep = " << P::tstep << " time = " << P::t << " block data reallocated per step (MiB) sum: " << sumReallocatedBytes/(1024*1024) <<
+      " max per process: " << maxReallocatedBytes/(1024*1024) << endl << flush;
 }
 
 
@@ -411,6 +424,12 @@ int main(int argn,char* args[]) {
          exit(1);
       }
    }
+   if (P::telemetryInterval != 0) {
+      if (telemetry::open(P::telemetryFileName, P::isRestart) == false) {
+         if(myRank == MASTER_RANK) cerr << "(MAIN) ERROR: failed to open telemetry file!" << endl;
+         exit(1);
+      }
+   }
    {
       int mpiProcs;
       MPI_Comm_size(MPI_COMM_WORLD,&mpiProcs);
@@ -421,6 +440,19 @@ int main(int argn,char* args[]) {
          logFile << "and 0";
       #endif
       logFile << " OpenMP threads per process" << endl << writeVerbose;      
+      #ifdef VEC_DISPATCH_HIGH
+         // Same checks as the resolver of the VEC_DISPATCH clones
+         __builtin_cpu_init();
+         logFile << "(MAIN) Vlasov kernels dispatched for ";
+         if (__builtin_cpu_supports(VEC_DISPATCH_HIGH)) {
+            logFile << VEC_DISPATCH_HIGH;
+         } else if (__builtin_cpu_supports(VEC_DISPATCH_MID)) {
+            logFile << VEC_DISPATCH_MID;
+         } else {
+            logFile << "the baseline instruction set";
+         }
+         logFile << " on the master rank" << endl << writeVerbose;
+      #endif
    }
    openLoggerTimer.stop();
    
@@ -853,6 +885,7 @@ int main(int argn,char* args[]) {
       addTimedBarrier("barrier-loop-start");
       
       phiprof::Timer ioTimer {"IO"};
+      telemetry::PhaseTimer ioPhase {telemetry::IO};
 
       phiprof::Timer externalsTimer {"checkExternalCommands"};
       if(myRank ==  MASTER_RANK) {
@@ -958,7 +991,9 @@ int main(int argn,char* args[]) {
 
       // Reduce globalflags::bailingOut from all processes
       phiprof::Timer bailoutReduceTimer {"Bailout-allreduce"};
+      telemetry::PhaseTimer bailoutReducePhase {telemetry::MPI_WAIT};
       MPI_Allreduce(&(globalflags::bailingOut), &(doBailout), 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+      bailoutReducePhase.stop();
       bailoutReduceTimer.stop();
 
       // Write restart data if needed
@@ -1039,6 +1074,7 @@ int main(int argn,char* args[]) {
       }
       
       ioTimer.stop();
+      ioPhase.stop();
       addTimedBarrier("barrier-end-io");
       
       //no need to propagate if we are on the final step, we just
@@ -1053,13 +1089,22 @@ int main(int argn,char* args[]) {
       //TODO - add LB measure and do LB if it exceeds threshold
       if(((P::tstep % P::rebalanceInterval == 0 && P::tstep > P::tstep_min) || overrideRebalanceNow)) {
          logFile << "(LB): Start load balance, tstep = " << P::tstep << " t = " << P::t << endl << writeVerbose;
+         telemetry::PhaseTimer loadBalancePhase {telemetry::LOAD_BALANCE};
+         bool balancedForRefinement = false;
          if (refineNow || (!dtIsChanged && P::adaptRefinement && P::tstep % (P::rebalanceInterval * P::refineCadence) == 0 && P::t > P::refineAfter)) { 
             logFile << "(AMR): Adapting refinement!"  << endl << writeVerbose;
             refineNow = false;
+            if (P::balanceBeforeRefine) {
+               // Migrate the coarse cells to where their children will live, refinement then happens in place
+               balanceLoadForRefinement(mpiGrid, sysBoundaryContainer, *project);
+               balancedForRefinement = true;
+            }
             if (!adaptRefinement(mpiGrid, technicalGrid, sysBoundaryContainer, *project)) {
                // OOM, rebalance and try again
                logFile << "(LB) AMR rebalancing with heavier refinement weights." << endl;
                globalflags::bailingOut = false; // Reset this
+               // The grid no longer matches the balance done for the refinement
+               balancedForRefinement = false;
                for (auto id : mpiGrid.get_local_cells_to_refine()) {
                   mpiGrid[id]->parameters[CellParams::LBWEIGHTCOUNTER] *= 8.0;
                }
@@ -1089,7 +1134,10 @@ int main(int argn,char* args[]) {
             calculateAcceleration(mpiGrid,0.0);
          }
          // This now uses the block-based count just copied between the two refinement calls above.
-         balanceLoad(mpiGrid, sysBoundaryContainer);
+         // Not needed if the load was already balanced for the refined grid.
+         if (!balancedForRefinement) {
+            balanceLoad(mpiGrid, sysBoundaryContainer);
+         }
          addTimedBarrier("barrier-end-load-balance");
          phiprof::Timer shrinkTimer {"Shrink_to_fit"};
          // * shrink to fit after LB * //
@@ -1168,12 +1216,14 @@ int main(int argn,char* args[]) {
       }
 
       phiprof::Timer spatialSpaceTimer {"Spatial-space"};
+      telemetry::PhaseTimer spatialSpacePhase {telemetry::TRANSLATION};
       if( P::propagateVlasovTranslation) {
          calculateSpatialTranslation(mpiGrid,P::dt);
       } else {
          calculateSpatialTranslation(mpiGrid,0.0);
       }
       spatialSpaceTimer.stop(computedCells, "Cells");
+      spatialSpacePhase.stop();
       
       // Apply boundary conditions
       if (P::propagateVlasovTranslation || P::propagateVlasovAcceleration ) {
@@ -1201,6 +1251,7 @@ int main(int argn,char* args[]) {
       // moments for t + dt are computed (field uses t and t+0.5dt)
       if (P::propagateField) {
          phiprof::Timer propagateTimer {"Propagate Fields"};
+         telemetry::PhaseTimer propagatePhase {telemetry::FIELD_SOLVER};
 
          phiprof::Timer couplingInTimer {"fsgrid-coupling-in"};
          // Copy moments over into the fsgrid.
@@ -1235,6 +1286,7 @@ int main(int argn,char* args[]) {
          getFieldsFromFsGrid(volGrid, BgBGrid, EGradPeGrid, technicalGrid, mpiGrid, cells);
          getFieldsTimer.stop();
          propagateTimer.stop(cells.size(),"SpatialCells");
+         propagatePhase.stop();
          addTimedBarrier("barrier-after-field-solver");
       }
       
@@ -1279,6 +1331,7 @@ int main(int argn,char* args[]) {
       }
       
       phiprof::Timer vspaceTimer {"Velocity-space"};
+      telemetry::PhaseTimer vspacePhase {telemetry::ACCELERATION};
       if ( P::propagateVlasovAcceleration ) {
          calculateAcceleration(mpiGrid,P::dt);
          addTimedBarrier("barrier-after-ad just-blocks");
@@ -1287,6 +1340,7 @@ int main(int argn,char* args[]) {
          calculateAcceleration(mpiGrid, 0.0);
       }
       vspaceTimer.stop(computedCells, "Cells");
+      vspacePhase.stop();
       addTimedBarrier("barrier-after-acceleration");
       
       if (P::propagateVlasovTranslation || P::propagateVlasovAcceleration ) {
@@ -1324,6 +1378,8 @@ int main(int argn,char* args[]) {
          s << "The timestep dt=" << P::dt << " went below bailout.bailout_min_dt (" << to_string(P::bailout_min_dt) << ")." << endl;
          bailout(true, s.str(), __FILE__, __LINE__);
       }
+      telemetry::recordStep(mpiGrid);
+
       //Move forward in time
       P::meshRepartitioned = false;
       globalflags::ionosphereJustSolved = false;
@@ -1367,7 +1423,11 @@ int main(int argn,char* args[]) {
    
    if (myRank == MASTER_RANK) logFile << "(MAIN): Exiting." << endl << writeVerbose;
    logFile.close();
-   if (P::diagnosticInterval != 0) diagnostic.close();
+   if (P::diagnosticInterval != 0) {
+      finalizeDiagnostic();
+      diagnostic.close();
+   }
+   telemetry::close();
    
    perBGrid.finalize();
    perBDt2Grid.finalize();
@@ -0,0 +1,108 @@
+/*
+ * This file is part of Vlasiator.
+ * Copyright 2010-2016 Finnish Meteorological Institute
+ *
+ * For details of usage, see the COPYING file and read the "Rules of the Road"
+ * at http://www.physics.helsinki.fi/vlasiator/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CPU_1D_RECONSTRUCTION_H
+#define CPU_1D_RECONSTRUCTION_H
+
+#include "../definitions.h"
+#include "vec.h"
+#include "cpu_1d_plm.hpp"
+#include "cpu_1d_ppm.hpp"
+#include "cpu_1d_pqm.hpp"
+
+/*!
+ Compute the reconstruction of order ORDER (PLM, PPM or PQM) in cell k. The
+ coefficients have the integration factors built in, see integrate_reconstruction.
+ ppmFaces and pqmFaces are the face estimates used by PPM and PQM, respectively.
+ Coefficients beyond the order are not set. The order is a template parameter so
+ that kernels instantiated per order contain no branches on it, see
+ select_reconstruction_order for choosing the instantiation once per column or block.
+*/
+template<reconstruction::Order ORDER>
+inline void compute_reconstruction_coeff(Vec *values, uint k,
+                                         face_estimate_order ppmFaces, face_estimate_order pqmFaces,
+                                         Vec a[5], const Realv threshold);
+
+template<>
+inline void compute_reconstruction_coeff<reconstruction::PLM>(Vec *values, uint k,
+                                                              face_estimate_order ppmFaces, face_estimate_order pqmFaces,
+                                                              Vec a[5], const Realv threshold){
+   compute_plm_coeff(values, k, a, threshold);
+}
+
+template<>
+inline void compute_reconstruction_coeff<reconstruction::PPM>(Vec *values, uint k,
+                                                              face_estimate_order ppmFaces, face_estimate_order pqmFaces,
+                                                              Vec a[5], const Realv threshold){
+   compute_ppm_coeff(values, ppmFaces, k, a, threshold);
+}
+
+template<>
+inline void compute_reconstruction_coeff<reconstruction::PQM>(Vec *values, uint k,
+                                                              face_estimate_order ppmFaces, face_estimate_order pqmFaces,
+                                                              Vec a[5], const Realv threshold){
+   compute_pqm_coeff(values, pqmFaces, k, a, threshold);
+}
+
+/*!
+ Integral of the reconstruction computed by compute_reconstruction_coeff<ORDER>, from
+ the left face of the cell to the normalized coordinate t (0 at the left and 1 at the
+ right face).
+*/
+template<reconstruction::Order ORDER>
+inline Vec integrate_reconstruction(const Vec a[5], const Vec& t);
+
+template<>
+inline Vec integrate_reconstruction<reconstruction::PLM>(const Vec a[5], const Vec& t){
+   return t * ( a[0] + t * a[1] );
+}
+
+template<>
+inline Vec integrate_reconstruction<reconstruction::PPM>(const Vec a[5], const Vec& t){
+   return t * ( a[0] + t * ( a[1] + t * a[2] ) );
+}
+
+template<>
+inline Vec integrate_reconstruction<reconstruction::PQM>(const Vec a[5], const Vec& t){
+   return t * ( a[0] + t * ( a[1] + t * ( a[2] + t * ( a[3] + t * a[4] ) ) ) );
+}
+
+/*!
+ Resolve reconstruction::ADAPTIVE for a column or stencil of n vectors: PQM if any
+ value exceeds threshold, PPM if the distribution is close to the sparsity threshold
+ everywhere. Other orders are returned as they are.
+*/
+inline reconstruction::Order select_reconstruction_order(const int order, const Vec * const values,
+                                                         const uint n, const Realv threshold){
+   if (order != reconstruction::ADAPTIVE) {
+      return static_cast<reconstruction::Order>(order);
+   }
+   const Vec limit(threshold);
+   for (uint i = 0; i < n; ++i) {
+      if (horizontal_or(values[i] > limit)) {
+         return reconstruction::PQM;
+      }
+   }
+   return reconstruction::PPM;
+}
+
+#endif
@@ -24,14 +24,16 @@
 #include <cmath>
 #include <algorithm>
 #include <utility>
+#ifdef _OPENMP
+   #include <omp.h>
+#endif
 
 #include "vec.h"
 #include "../object_wrapper.h"
 #include "cpu_acc_sort_blocks.hpp"
 #include "cpu_acc_load_blocks.hpp"
-#include "cpu_1d_pqm.hpp"
-#include "cpu_1d_ppm.hpp"
-#include "cpu_1d_plm.hpp"
+#include "cpu_1d_reconstruction.hpp"
+#include "cpu_moments.h"
 #include "cpu_acc_map.hpp"
 
 using namespace std;
@@ -103,21 +105,197 @@ void inline swapBlockIndices(velocity_block_indices_t &blockIndices, const uint
 
 
 
+/*
+   Map one column of blocks along the (swapped) z dimension using the
+   reconstruction ORDER. Templated on the order so that the reconstruction
+   is resolved at compile time, map_1d dispatches once per column.
+*/
+template<reconstruction::Order ORDER>
+static VEC_DISPATCH_INLINE void mapColumn(Vec * const columnValues, const vmesh::LocalID n_cblocks,
+                                          const velocity_block_indices_t& block_indices_begin,
+                                          const int columnMinBlockK, const int columnMaxBlockK,
+                                          const Realv intersection, const Realv intersection_di,
+                                          const Realv intersection_dj, const Realv intersection_dk,
+                                          const Realv v_min, const Realv dv, const Realv i_dv,
+                                          const uint cell_indices_to_id[3], const uint dimension,
+                                          Realf * const * blockIndexToBlockData, const Realv minValue) {
+   /*  i,j,k are now relative to the order in which we copied data to the values array. 
+       After this point in the k,j,i loops there should be no branches based on dimensions
+ 
+       Note that the i dimension is vectorized, and thus there are no loops over i
+   */
+   for (int j = 0; j < WID; j += VECL/WID){
+      // create vectors with the i and j indices in the vector position on the plane.
+      #if VECL == 4       
+      const Veci i_indices = Veci(0, 1, 2, 3);
+      const Veci j_indices = Veci(j, j, j, j);
+      #elif VECL == 8
+      const Veci i_indices = Veci(0, 1, 2, 3,
+                                  0, 1, 2, 3);
+      const Veci j_indices = Veci(j, j, j, j,
+                                  j + 1, j + 1, j + 1, j + 1);
+      #elif VECL == 16
+      const Veci i_indices = Veci(0, 1, 2, 3,
+                                  0, 1, 2, 3,
+                                  0, 1, 2, 3,
+                                  0, 1, 2, 3);
+      const Veci j_indices = Veci(j, j, j, j,
+                                  j + 1, j + 1, j + 1, j + 1,
+                                  j + 2, j + 2, j + 2, j + 2,
+                                  j + 3, j + 3, j + 3, j + 3);
+      #endif
+
+      const Veci  target_cell_index_common =
+         i_indices * cell_indices_to_id[0] +
+         j_indices * cell_indices_to_id[1];
+
+      /* 
+         intersection_min is the intersection z coordinate (z after
+         swaps that is) of the lowest possible z plane for each i,j
+         index (i in vector)
+      */
+
+      const Vec intersection_min =
+         intersection +
+         (block_indices_begin[0] * WID + to_realv(i_indices)) * intersection_di + 
+         (block_indices_begin[1] * WID + to_realv(j_indices)) * intersection_dj;
+   
+      /*compute some initial values, that are used to set up the
+       * shifting of values as we go through all blocks in
+       * order. See comments where they are shifted for
+       * explanations of their meaning*/
+      Vec v_r((WID * block_indices_begin[2]) * dv + v_min);
+      Vec lagrangian_v_r((v_r-intersection_min)/intersection_dk);
+   #if VECTORCLASS_H >= 20000
+      Veci lagrangian_gk_r=truncatei(lagrangian_v_r);
+   #else
+      Veci lagrangian_gk_r=truncate_to_int(lagrangian_v_r);
+   #endif
+
+      /*compute location of min and max, this does not change for one
+       * column (or even for this set of intersections, and can be used
+       * to quickly compute max and min later on*/
+      //TODO, these can be computed much earlier, since they are
+      //identiacal for each set of intersections
+      int minGkIndex=0, maxGkIndex=0; // 0 for compiler
+      {
+         Realv maxV = std::numeric_limits<Realv>::min();
+         Realv minV = std::numeric_limits<Realv>::max();
+         for(int i = 0; i < VECL; i++) {
+            if ( lagrangian_v_r[i] > maxV) {
+               maxV = lagrangian_v_r[i];
+               maxGkIndex = i;
+            }
+            if ( lagrangian_v_r[i] < minV) {
+               minV = lagrangian_v_r[i];
+               minGkIndex = i;
+            }
+         }
+      }
+   
+   
+      // loop through all blocks in column and compute the mapping as integrals.
+      for (uint k=0; k < WID * n_cblocks; ++k ){
+         // Compute reconstructions 
+         // values + i_pcolumnv(n_cblocks, -1, j, 0) is the starting point of the column data for fixed j
+         // k + WID is the index where we have stored k index, WID amount of padding.
+         Vec a[5];
+         compute_reconstruction_coeff<ORDER>(columnValues + i_pcolumnv(j, 0, -1, n_cblocks), k + WID,
+                                                h4, h8, a, minValue);
+      
+         // set the initial value for the integrand at the boundary at v = 0 
+         // (in reduced cell units), this will be shifted to target_density_1, see below.
+         Vec target_density_r(0.0);
+         // v_l, v_r are the left and right velocity coordinates of source cell. Left is the old right.
+         Vec v_l = v_r; 
+         v_r += dv;
+      
+         // left(l) and right(r) k values (global index) in the target
+         // Lagrangian grid, the intersecting cells. Again old right is new left.
+         const Veci lagrangian_gk_l = lagrangian_gk_r;
+   #if VECTORCLASS_H >= 20000
+         lagrangian_gk_r = truncatei((v_r-intersection_min)/intersection_dk);
+   #else
+         lagrangian_gk_r = truncate_to_int((v_r-intersection_min)/intersection_dk);
+   #endif
+      
+         //limits in lagrangian k for target column. Also take into
+         //account limits of target column
+         int minGk = std::max(int(lagrangian_gk_l[minGkIndex]), int(columnMinBlockK * WID));
+         int maxGk = std::min(int(lagrangian_gk_r[maxGkIndex]), int((columnMaxBlockK + 1) * WID - 1));
+      
+         for(int gk = minGk; gk <= maxGk; gk++){ 
+            const int blockK = gk/WID;
+            const int gk_mod_WID = (gk - blockK * WID);
+
+         
+            //cell indices in the target block  (TODO: to be replaced by
+            //compile time generated scatter write operation)
+            const Veci target_cell(target_cell_index_common + gk_mod_WID * cell_indices_to_id[2]);
+      
+            //the velocity between which we will integrate to put mass
+            //in the targe cell. If both v_r and v_l are in same cell
+            //then v_1,v_2 should be between v_l and v_r.
+            //v_1 and v_2 normalized to be between 0 and 1 in the cell.
+            //For vector elements where gk is already larger than needed (lagrangian_gk_r), v_2=v_1=v_r and thus the value is zero.
+            const Vec v_norm_r = (  min(  max( (gk + 1) * intersection_dk + intersection_min, v_l), v_r) - v_l) * i_dv;
+            /*shift, old right is new left*/
+            const Vec target_density_l = target_density_r;
+
+            // compute right integrand
+            target_density_r = integrate_reconstruction<ORDER>(a, v_norm_r);
+         
+            //store values, one element at a time. All blocks
+            //have been created by now.
+            //TODO replace by vector version & scatter & gather operation
+         
+         
+            if(dimension == 2) {
+               Realf* targetDataPointer = blockIndexToBlockData[blockK] + j * cell_indices_to_id[1] + gk_mod_WID * cell_indices_to_id[2];
+               Vec targetData;
+               targetData.load_a(targetDataPointer);
+               targetData += target_density_r - target_density_l;                  
+               targetData.store_a(targetDataPointer);
+            }
+            else{
+               // total value of integrand
+               const Vec target_density = target_density_r - target_density_l;                  
+   #pragma omp simd
+               for (int target_i=0; target_i < VECL; ++target_i) {
+                  // do the conversion from Realv to Realf here, faster than doing it in accumulation
+                  const Realf tval = target_density[target_i];
+                  const uint tcell = target_cell[target_i];
+                  blockIndexToBlockData[blockK][tcell] += tval;
+               }  // for-loop over vector elements
+            }
+         
+         } // for loop over target k-indices of current source block
+      } // for-loop over source blocks
+   } //for loop over j index
+}
+
 /* 
    Here we map from the current time step grid, to a target grid which
    is the lagrangian departure grid (so th grid at timestep +dt,
    tracked backwards by -dt)
 
-   TODO: parallelize with openMP over block-columns. If one also
-   pre-creates new blocks in a separate loop first (serial operation),
-   then the openmp parallization would scale well (better than over
-   spatial cells), and would not need synchronization.
+   New target blocks are created in a separate serial loop first, and
+   source blocks that are not target blocks are removed after the
+   mapping. In between the block column sets are independent, and are
+   shared between threads if map_1d is called outside of a parallel
+   region.
+
+   If momentSums is not NULL, the zeroth and first velocity moments
+   of the mapped distribution are added to it, see
+   blockVelocityFirstMoments.
    
 */
+VEC_DISPATCH
 bool map_1d(SpatialCell* spatial_cell,
             const uint popID,     
             Realv intersection, Realv intersection_di, Realv intersection_dj,Realv intersection_dk,
-            const uint dimension) {
+            const uint dimension,
+            Real* momentSums) {
    no_subnormals();
 
    Realv dv,v_min;
@@ -200,45 +378,27 @@ bool map_1d(SpatialCell* spatial_cell,
    std::vector<uint> columnNumBlocks;
    std::vector<uint> setColumnOffsets;
    std::vector<uint> setNumColumns;
-   std::vector<int> columnMinBlockK;
-   std::vector<int> columnMaxBlockK;
    
    sortBlocklistByDimension(vmesh, dimension, blocks,
                             columnBlockOffsets, columnNumBlocks,
                             setColumnOffsets, setNumColumns);
-   
-   // loop over block column sets  (all columns along the dimension with the other dimensions being equal )
-      
-/*   
-     values array used to store column data The max size is the worst
-     case scenario with every second block having content, creating up
-     to ( MAX_BLOCKS_PER_DIM / 2 + 1) columns with each needing three
-     blocks (two for padding)
-*/
-   Vec values[(3 * ( MAX_BLOCKS_PER_DIM / 2 + 1)) * WID3 / VECL];
-   /*pointers to target block datas*/
-   Realf *blockIndexToBlockData[MAX_BLOCKS_PER_DIM];
-   bool isTargetBlock[MAX_BLOCKS_PER_DIM];
-   bool isSourceBlock[MAX_BLOCKS_PER_DIM];
 
+   // target block range of each column
+   std::vector<int> columnMinBlockK(columnNumBlocks.size());
+   std::vector<int> columnMaxBlockK(columnNumBlocks.size());
+
+   /*Compute target blocks of each block column set (all columns along the
+     dimension with the other dimensions being equal), and add the ones
+     that do not exist yet. The velocity mesh is not modified again until
+     all sets have been mapped, so that the sets can be mapped in parallel.*/
    for(uint setIndex=0; setIndex< setColumnOffsets.size(); ++setIndex) {
       uint8_t refLevel = 0;
-      //init 
+      bool isTargetBlock[MAX_BLOCKS_PER_DIM];
+      bool isSourceBlock[MAX_BLOCKS_PER_DIM];
       for (uint blockK = 0; blockK < MAX_BLOCKS_PER_DIM; blockK++){
-         blockIndexToBlockData[blockK] =  NULL;
          isTargetBlock[blockK] = false;
          isSourceBlock[blockK] = false;
       }
-      
-      //Load data into values array (this also zeroes the original data)
-      uint valuesColumnOffset = 0; //offset to values array for data in a column in this set
-      for(uint columnIndex = setColumnOffsets[setIndex]; columnIndex < setColumnOffsets[setIndex] + setNumColumns[setIndex] ; columnIndex ++){
-         const vmesh::LocalID n_cblocks = columnNumBlocks[columnIndex];
-         vmesh::GlobalID* cblocks = blocks + columnBlockOffsets[columnIndex]; //column blocks
-         loadColumnBlockData(vmesh, blockContainer, cblocks, n_cblocks, dimension, values + valuesColumnOffset);
-         valuesColumnOffset += (n_cblocks + 2) * (WID3/VECL); // there are WID3/VECL elements of type Vec per block
-      }
-
 
       /*need x,y coordinate of this column set of blocks, take it from first
         block in first column*/
@@ -346,12 +506,11 @@ bool map_1d(SpatialCell* spatial_cell,
          }
 
          //store also for each column firstBlockIndexK, and lastBlockIndexK
-         columnMinBlockK.push_back(firstBlockIndexK);
-         columnMaxBlockK.push_back(lastBlockIndexK);
+         columnMinBlockK[columnIndex] = firstBlockIndexK;
+         columnMaxBlockK[columnIndex] = lastBlockIndexK;
       }
 
-      //now add target blocks that do not yet exist and remove source blocks
-      //that are not target blocks
+      //now add target blocks that do not yet exist
       for (uint blockK = 0; blockK < MAX_BLOCKS_PER_DIM; blockK++){
          if(isTargetBlock[blockK] && !isSourceBlock[blockK] )  {
             const int targetBlock =
@@ -359,228 +518,191 @@ bool map_1d(SpatialCell* spatial_cell,
                setFirstBlockIndices[1] * block_indices_to_id[1] +
                blockK                  * block_indices_to_id[2];
             addVelocityBlock(targetBlock, vmesh, blockContainer);
-            
          }
-         if(!isTargetBlock[blockK] && isSourceBlock[blockK] )  {
-            const int targetBlock =
-               setFirstBlockIndices[0] * block_indices_to_id[0] +
-               setFirstBlockIndices[1] * block_indices_to_id[1] +
-               blockK                  * block_indices_to_id[2];
+      }
+   }
 
-            spatial_cell->remove_velocity_block(targetBlock, popID);
+   /*Map the column sets. Each set reads and writes only its own blocks, so
+     when map_1d is called outside of a parallel region (a large cell) the
+     sets are shared between all threads. Inside a parallel region (one
+     cell per thread) the region below has only one thread.*/
+   #pragma omp parallel if(!omp_in_parallel())
+   {
+      no_subnormals();
+      Real threadMomentSums[4] = {0.0, 0.0, 0.0, 0.0};
+
+/*   
+     values array used to store column data The max size is the worst
+     case scenario with every second block having content, creating up
+     to ( MAX_BLOCKS_PER_DIM / 2 + 1) columns with each needing three
+     blocks (two for padding)
+*/
+      Vec values[(3 * ( MAX_BLOCKS_PER_DIM / 2 + 1)) * WID3 / VECL];
+      /*pointers to target block datas*/
+      Realf *blockIndexToBlockData[MAX_BLOCKS_PER_DIM];
+      const Real *blockIndexToBlockParams[MAX_BLOCKS_PER_DIM];
+      bool isTargetBlock[MAX_BLOCKS_PER_DIM];
+
+      #pragma omp for schedule(dynamic,1)
+      for(uint setIndex=0; setIndex< setColumnOffsets.size(); ++setIndex) {
+         uint8_t refLevel = 0;
+         //init 
+         for (uint blockK = 0; blockK < MAX_BLOCKS_PER_DIM; blockK++){
+            blockIndexToBlockData[blockK] =  NULL;
+            blockIndexToBlockParams[blockK] =  NULL;
+            isTargetBlock[blockK] = false;
+         }
+
+         //Load data into values array (this also zeroes the original data)
+         uint valuesColumnOffset = 0; //offset to values array for data in a column in this set
+         for(uint columnIndex = setColumnOffsets[setIndex]; columnIndex < setColumnOffsets[setIndex] + setNumColumns[setIndex] ; columnIndex ++){
+            const vmesh::LocalID n_cblocks = columnNumBlocks[columnIndex];
+            vmesh::GlobalID* cblocks = blocks + columnBlockOffsets[columnIndex]; //column blocks
+            loadColumnBlockData(vmesh, blockContainer, cblocks, n_cblocks, dimension, values + valuesColumnOffset);
+            valuesColumnOffset += (n_cblocks + 2) * (WID3/VECL); // there are WID3/VECL elements of type Vec per block
+            //target blocks of this column
+            for (int blockK = columnMinBlockK[columnIndex]; blockK <= columnMaxBlockK[columnIndex]; blockK++){
+               isTargetBlock[blockK] = true;
+            }
+         }
+
+         /*need x,y coordinate of this column set of blocks, take it from first
+           block in first column*/
+         velocity_block_indices_t setFirstBlockIndices;
+         vmesh.getIndices(blocks[columnBlockOffsets[setColumnOffsets[setIndex]]],
+                          refLevel, 
+                          setFirstBlockIndices[0], setFirstBlockIndices[1], setFirstBlockIndices[2]);
+         swapBlockIndices(setFirstBlockIndices, dimension);
+
+         /*now store pointer to blocks. No blocks are added or removed while
+           the sets are mapped, so these stay valid*/
+         for (int blockK = 0; blockK < MAX_BLOCKS_PER_DIM; blockK++){
+            if(isTargetBlock[blockK])  {
+               const int targetBlock =
+                  setFirstBlockIndices[0] * block_indices_to_id[0] +
+                  setFirstBlockIndices[1] * block_indices_to_id[1] +
+                  blockK                  * block_indices_to_id[2];
+               const vmesh::LocalID tblockLID = vmesh.getLocalID(targetBlock);
+               // Get pointer to target block data.
+               blockIndexToBlockData[blockK] = blockContainer.getData(tblockLID);
+               blockIndexToBlockParams[blockK] = blockContainer.getParameters(tblockLID);
+            }
+         }
+
+         // loop over columns in set and do the mapping
+         valuesColumnOffset = 0; //offset to values array for data in a column in this set
+         for(uint columnIndex = setColumnOffsets[setIndex]; columnIndex < setColumnOffsets[setIndex] + setNumColumns[setIndex] ; columnIndex ++){
+            const vmesh::LocalID n_cblocks = columnNumBlocks[columnIndex];
+            vmesh::GlobalID* cblocks = blocks + columnBlockOffsets[columnIndex]; //column blocks
+      
+            // compute the common indices for this block column set
+            //First block in column
+            velocity_block_indices_t block_indices_begin;
+            uint8_t refLevel;
+            vmesh.getIndices(cblocks[0],refLevel,block_indices_begin[0],block_indices_begin[1],block_indices_begin[2]);
+         
+            // Switch block indices according to dimensions, the algorithm has
+            // been written for integrating along z.
+            swapBlockIndices(block_indices_begin, dimension);
+
+            // Reconstruction for this column, adaptive mode uses PQM only if the column has significant values
+            const reconstruction::Order columnOrder =
+               select_reconstruction_order(P::vlasovAccelerationReconstruction,
+                                           values + valuesColumnOffset, (n_cblocks + 2) * (WID3/VECL),
+                                           P::vlasovAdaptiveReconstructionThreshold * spatial_cell->getVelocityBlockMinValue(popID));
+
+            // Dispatch once per column to the kernel compiled for the reconstruction order
+            const Realv minValue = spatial_cell->getVelocityBlockMinValue(popID);
+            switch (columnOrder) {
+            case reconstruction::PLM:
+               mapColumn<reconstruction::PLM>(values + valuesColumnOffset, n_cblocks, block_indices_begin,
+                                              columnMinBlockK[columnIndex], columnMaxBlockK[columnIndex],
+                                              intersection, intersection_di, intersection_dj, intersection_dk,
+                                              v_min, dv, i_dv, cell_indices_to_id, dimension,
+                                              blockIndexToBlockData, minValue);
+               break;
+            case reconstruction::PPM:
+               mapColumn<reconstruction::PPM>(values + valuesColumnOffset, n_cblocks, block_indices_begin,
+                                              columnMinBlockK[columnIndex], columnMaxBlockK[columnIndex],
+                                              intersection, intersection_di, intersection_dj, intersection_dk,
+                                              v_min, dv, i_dv, cell_indices_to_id, dimension,
+                                              blockIndexToBlockData, minValue);
+               break;
+            default:
+               mapColumn<reconstruction::PQM>(values + valuesColumnOffset, n_cblocks, block_indices_begin,
+                                              columnMinBlockK[columnIndex], columnMaxBlockK[columnIndex],
+                                              intersection, intersection_di, intersection_dj, intersection_dk,
+                                              v_min, dv, i_dv, cell_indices_to_id, dimension,
+                                              blockIndexToBlockData, minValue);
+               break;
+            }
+            valuesColumnOffset += (n_cblocks + 2) * (WID3/VECL) ;// there are WID3/VECL elements of type Vec per block    
+         } //for loop over columns
+         // All target blocks of this set are final now and still in cache
+         if (momentSums != NULL) {
+            for (uint blockK = 0; blockK < MAX_BLOCKS_PER_DIM; blockK++){
+               if(isTargetBlock[blockK]) {
+                  blockVelocityFirstMoments(blockIndexToBlockData[blockK], blockIndexToBlockParams[blockK], threadMomentSums);
+               }
+            }
+         }
+      } //for loop over column sets
+
+      if (momentSums != NULL) {
+         #pragma omp critical
+         {
+            for (int i = 0; i < 4; i++) {
+               momentSums[i] += threadMomentSums[i];
+            }
          }
       }
+   }
 
-     /*now store pointer to blocks, cannot do it at the same time as adding
-      them since they might move due to re-allocations or migrated when
-      removing blocks*/
-      for (int blockK = 0; blockK < MAX_BLOCKS_PER_DIM; blockK++){
-         if(isTargetBlock[blockK])  {
+   //remove source blocks that are not target blocks, their data was zeroed when loaded
+   for(uint setIndex=0; setIndex< setColumnOffsets.size(); ++setIndex) {
+      uint8_t refLevel = 0;
+      bool isTargetBlock[MAX_BLOCKS_PER_DIM];
+      bool isSourceBlock[MAX_BLOCKS_PER_DIM];
+      for (uint blockK = 0; blockK < MAX_BLOCKS_PER_DIM; blockK++){
+         isTargetBlock[blockK] = false;
+         isSourceBlock[blockK] = false;
+      }
+      for(uint columnIndex = setColumnOffsets[setIndex]; columnIndex < setColumnOffsets[setIndex] + setNumColumns[setIndex] ; columnIndex ++){
+         const vmesh::LocalID n_cblocks = columnNumBlocks[columnIndex];
+         vmesh::GlobalID* cblocks = blocks + columnBlockOffsets[columnIndex]; //column blocks
+         velocity_block_indices_t firstBlockIndices;
+         velocity_block_indices_t lastBlockIndices;
+         vmesh.getIndices(cblocks[0],
+                          refLevel, 
+                          firstBlockIndices[0], firstBlockIndices[1], firstBlockIndices[2]);
+         vmesh.getIndices(cblocks[n_cblocks -1],
+                          refLevel, 
+                          lastBlockIndices[0], lastBlockIndices[1], lastBlockIndices[2]);
+         swapBlockIndices(firstBlockIndices, dimension);
+         swapBlockIndices(lastBlockIndices, dimension);
+         for (uint blockK = firstBlockIndices[2]; blockK <= lastBlockIndices[2]; blockK++){
+            isSourceBlock[blockK] = true;
+         }
+         for (int blockK = columnMinBlockK[columnIndex]; blockK <= columnMaxBlockK[columnIndex]; blockK++){
+            isTargetBlock[blockK] = true;
+         }
+      }
+
+      velocity_block_indices_t setFirstBlockIndices;
+      vmesh.getIndices(blocks[columnBlockOffsets[setColumnOffsets[setIndex]]],
+                       refLevel, 
+                       setFirstBlockIndices[0], setFirstBlockIndices[1], setFirstBlockIndices[2]);
+      swapBlockIndices(setFirstBlockIndices, dimension);
+      for (uint blockK = 0; blockK < MAX_BLOCKS_PER_DIM; blockK++){
+         if(!isTargetBlock[blockK] && isSourceBlock[blockK] )  {
             const int targetBlock =
                setFirstBlockIndices[0] * block_indices_to_id[0] +
                setFirstBlockIndices[1] * block_indices_to_id[1] +
                blockK                  * block_indices_to_id[2];
-            const vmesh::LocalID tblockLID = vmesh.getLocalID(targetBlock);
-            // Get pointer to target block data.
-            blockIndexToBlockData[blockK] = blockContainer.getData(tblockLID);
+
+            spatial_cell->remove_velocity_block(targetBlock, popID);
          }
       }
-      
-      
-      
-      // loop over columns in set and do the mapping
-      valuesColumnOffset = 0; //offset to values array for data in a column in this set
-      for(uint columnIndex = setColumnOffsets[setIndex]; columnIndex < setColumnOffsets[setIndex] + setNumColumns[setIndex] ; columnIndex ++){
-         const vmesh::LocalID n_cblocks = columnNumBlocks[columnIndex];
-         vmesh::GlobalID* cblocks = blocks + columnBlockOffsets[columnIndex]; //column blocks
-      
-         // compute the common indices for this block column set
-         //First block in column
-         velocity_block_indices_t block_indices_begin;
-         uint8_t refLevel;
-         vmesh.getIndices(cblocks[0],refLevel,block_indices_begin[0],block_indices_begin[1],block_indices_begin[2]);
-         
-         // Switch block indices according to dimensions, the algorithm has
-         // been written for integrating along z.
-         swapBlockIndices(block_indices_begin, dimension);
-
-         /*  i,j,k are now relative to the order in which we copied data to the values array. 
-             After this point in the k,j,i loops there should be no branches based on dimensions
-          
-             Note that the i dimension is vectorized, and thus there are no loops over i
-         */
-         for (int j = 0; j < WID; j += VECL/WID){
-            // create vectors with the i and j indices in the vector position on the plane.
-            #if VECL == 4       
-            const Veci i_indices = Veci(0, 1, 2, 3);
-            const Veci j_indices = Veci(j, j, j, j);
-            #elif VECL == 8
-            const Veci i_indices = Veci(0, 1, 2, 3,
-                                        0, 1, 2, 3);
-            const Veci j_indices = Veci(j, j, j, j,
-                                        j + 1, j + 1, j + 1, j + 1);
-            #elif VECL == 16
-            const Veci i_indices = Veci(0, 1, 2, 3,
-                                        0, 1, 2, 3,
-                                        0, 1, 2, 3,
-                                        0, 1, 2, 3);
-            const Veci j_indices = Veci(j, j, j, j,
-                                        j + 1, j + 1, j + 1, j + 1,
-                                        j + 2, j + 2, j + 2, j + 2,
-                                        j + 3, j + 3, j + 3, j + 3);
-            #endif
-
-            const Veci  target_cell_index_common =
-               i_indices * cell_indices_to_id[0] +
-               j_indices * cell_indices_to_id[1];
-       
-            /* 
-               intersection_min is the intersection z coordinate (z after
-               swaps that is) of the lowest possible z plane for each i,j
-               index (i in vector)
-            */
-       
-            const Vec intersection_min =
-               intersection +
-               (block_indices_begin[0] * WID + to_realv(i_indices)) * intersection_di + 
-               (block_indices_begin[1] * WID + to_realv(j_indices)) * intersection_dj;
-            
-            /*compute some initial values, that are used to set up the
-             * shifting of values as we go through all blocks in
-             * order. See comments where they are shifted for
-             * explanations of their meaning*/
-            Vec v_r((WID * block_indices_begin[2]) * dv + v_min);
-            Vec lagrangian_v_r((v_r-intersection_min)/intersection_dk);
-#if VECTORCLASS_H >= 20000
-            Veci lagrangian_gk_r=truncatei(lagrangian_v_r);
-#else
-            Veci lagrangian_gk_r=truncate_to_int(lagrangian_v_r);
-#endif
-
-            /*compute location of min and max, this does not change for one
-             * column (or even for this set of intersections, and can be used
-             * to quickly compute max and min later on*/
-            //TODO, these can be computed much earlier, since they are
-            //identiacal for each set of intersections
-            int minGkIndex=0, maxGkIndex=0; // 0 for compiler
-            {
-               Realv maxV = std::numeric_limits<Realv>::min();
-               Realv minV = std::numeric_limits<Realv>::max();
-               for(int i = 0; i < VECL; i++) {
-                  if ( lagrangian_v_r[i] > maxV) {
-                     maxV = lagrangian_v_r[i];
-                     maxGkIndex = i;
-                  }
-                  if ( lagrangian_v_r[i] < minV) {
-                     minV = lagrangian_v_r[i];
-                     minGkIndex = i;
-                  }
-               }
-            }
-            
-            
-            // loop through all blocks in column and compute the mapping as integrals.
-            for (uint k=0; k < WID * n_cblocks; ++k ){
-               // Compute reconstructions 
-               // values + i_pcolumnv(n_cblocks, -1, j, 0) is the starting point of the column data for fixed j
-               // k + WID is the index where we have stored k index, WID amount of padding.
-               #ifdef ACC_SEMILAG_PLM
-               Vec a[2];
-               compute_plm_coeff(values + valuesColumnOffset + i_pcolumnv(j, 0, -1, n_cblocks), k + WID , a, spatial_cell->getVelocityBlockMinValue(popID));
-               #endif
-               #ifdef ACC_SEMILAG_PPM
-               Vec a[3];
-               compute_ppm_coeff(values + valuesColumnOffset + i_pcolumnv(j, 0, -1, n_cblocks), h4, k + WID, a, spatial_cell->getVelocityBlockMinValue(popID));
-               #endif
-               #ifdef ACC_SEMILAG_PQM
-               Vec a[5];
-               compute_pqm_coeff(values + valuesColumnOffset + i_pcolumnv(j, 0, -1, n_cblocks), h8, k + WID, a, spatial_cell->getVelocityBlockMinValue(popID));
-               #endif
-               
-               // set the initial value for the integrand at the boundary at v = 0 
-               // (in reduced cell units), this will be shifted to target_density_1, see below.
-               Vec target_density_r(0.0);
-               // v_l, v_r are the left and right velocity coordinates of source cell. Left is the old right.
-               Vec v_l = v_r; 
-               v_r += dv;
-               
-               // left(l) and right(r) k values (global index) in the target
-               // Lagrangian grid, the intersecting cells. Again old right is new left.
-               const Veci lagrangian_gk_l = lagrangian_gk_r;
-#if VECTORCLASS_H >= 20000
-               lagrangian_gk_r = truncatei((v_r-intersection_min)/intersection_dk);
-#else
-               lagrangian_gk_r = truncate_to_int((v_r-intersection_min)/intersection_dk);
-#endif
-               
-               //limits in lagrangian k for target column. Also take into
-               //account limits of target column
-               int minGk = std::max(int(lagrangian_gk_l[minGkIndex]), int(columnMinBlockK[columnIndex] * WID));
-               int maxGk = std::min(int(lagrangian_gk_r[maxGkIndex]), int((columnMaxBlockK[columnIndex] + 1) * WID - 1));
-               
-               for(int gk = minGk; gk <= maxGk; gk++){ 
-                  const int blockK = gk/WID;
-                  const int gk_mod_WID = (gk - blockK * WID);
-
-                  
-                  //cell indices in the target block  (TODO: to be replaced by
-                  //compile time generated scatter write operation)
-                  const Veci target_cell(target_cell_index_common + gk_mod_WID * cell_indices_to_id[2]);
-               
-                  //the velocity between which we will integrate to put mass
-                  //in the targe cell. If both v_r and v_l are in same cell
-                  //then v_1,v_2 should be between v_l and v_r.
-                  //v_1 and v_2 normalized to be between 0 and 1 in the cell.
-                  //For vector elements where gk is already larger than needed (lagrangian_gk_r), v_2=v_1=v_r and thus the value is zero.
-                  const Vec v_norm_r = (  min(  max( (gk + 1) * intersection_dk + intersection_min, v_l), v_r) - v_l) * i_dv;
-                  /*shift, old right is new left*/
-                  const Vec target_density_l = target_density_r;
-
-                  // compute right integrand
-                  #ifdef ACC_SEMILAG_PLM
-                  target_density_r =
-                     v_norm_r * ( a[0] + v_norm_r * a[1] );
-                  #endif
-                  #ifdef ACC_SEMILAG_PPM
-                  target_density_r =
-                     v_norm_r * ( a[0] + v_norm_r * ( a[1] + v_norm_r * a[2] ) );
-
-                  #endif
-                  #ifdef ACC_SEMILAG_PQM
-                  target_density_r =
-                     v_norm_r * ( a[0] + v_norm_r * ( a[1] + v_norm_r * ( a[2] + v_norm_r * ( a[3] + v_norm_r * a[4] ) ) ) );
-                  #endif
-                  
-                  //store values, one element at a time. All blocks
-                  //have been created by now.
-                  //TODO replace by vector version & scatter & gather operation
-                  
-                  
-                  if(dimension == 2) {
-                     Realf* targetDataPointer = blockIndexToBlockData[blockK] + j * cell_indices_to_id[1] + gk_mod_WID * cell_indices_to_id[2];
-                     Vec targetData;
-                     targetData.load_a(targetDataPointer);
-                     targetData += target_density_r - target_density_l;                  
-                     targetData.store_a(targetDataPointer);
-                  }
-                  else{
-                     // total value of integrand
-                     const Vec target_density = target_density_r - target_density_l;                  
-#pragma omp simd
-                     for (int target_i=0; target_i < VECL; ++target_i) {
-                        // do the conversion from Realv to Realf here, faster than doing it in accumulation
-                        const Realf tval = target_density[target_i];
-                        const uint tcell = target_cell[target_i];
-                        blockIndexToBlockData[blockK][tcell] += tval;
-                     }  // for-loop over vector elements
-                  }
-                  
-               } // for loop over target k-indices of current source block
-            } // for-loop over source blocks
-         } //for loop over j index
-         valuesColumnOffset += (n_cblocks + 2) * (WID3/VECL) ;// there are WID3/VECL elements of type Vec per block    
-      } //for loop over columns
-      
    }
    delete [] blocks;
    return true;
@@ -79,12 +79,15 @@ uint getAccelerationSubcycles(SpatialCell* spatial_cell, Real dt, const uint pop
  * @param blockContainer Velocity block data container.
  * @param map_order Order in which vx,vy,vz mappings are performed. 
  * @param dt Time step of one subcycle.
+ * @param momentSums If not NULL, zeroth and first moments of the accelerated
+ * population are accumulated here by the last mapping, see blockVelocityFirstMoments.
 */
 
 void cpu_accelerate_cell(SpatialCell* spatial_cell,
                          const uint popID,     
                          const uint map_order,
-                         const Real& dt) {
+                         const Real& dt,
+                         Real* momentSums) {
    //double t1 = MPI_Wtime();
 
    vmesh::VelocityMesh<vmesh::GlobalID,vmesh::LocalID>& vmesh    = spatial_cell->get_velocity_mesh(popID);
@@ -118,7 +121,7 @@ void cpu_accelerate_cell(SpatialCell* spatial_cell,
          phiprof::Timer mappingTimer {mapping_id};
          map_1d(spatial_cell, popID, intersection_x,intersection_x_di,intersection_x_dj,intersection_x_dk,0); // map along x
          map_1d(spatial_cell, popID, intersection_y,intersection_y_di,intersection_y_dj,intersection_y_dk,1); // map along y
-         map_1d(spatial_cell, popID, intersection_z,intersection_z_di,intersection_z_dj,intersection_z_dk,2); // map along z
+         map_1d(spatial_cell, popID, intersection_z,intersection_z_di,intersection_z_dj,intersection_z_dk,2,momentSums); // map along z
          mappingTimer.stop();
          break;
       }
@@ -137,7 +140,7 @@ void cpu_accelerate_cell(SpatialCell* spatial_cell,
          phiprof::Timer mappingTimer {mapping_id};
          map_1d(spatial_cell, popID, intersection_y,intersection_y_di,intersection_y_dj,intersection_y_dk,1); // map along y
          map_1d(spatial_cell, popID, intersection_z,intersection_z_di,intersection_z_dj,intersection_z_dk,2); // map along z
-         map_1d(spatial_cell, popID, intersection_x,intersection_x_di,intersection_x_dj,intersection_x_dk,0); // map along x
+         map_1d(spatial_cell, popID, intersection_x,intersection_x_di,intersection_x_dj,intersection_x_dk,0,momentSums); // map along x
          mappingTimer.stop();
          break;
       }
@@ -155,7 +158,7 @@ void cpu_accelerate_cell(SpatialCell* spatial_cell,
          phiprof::Timer mappingTimer {mapping_id};
          map_1d(spatial_cell, popID, intersection_z,intersection_z_di,intersection_z_dj,intersection_z_dk,2); // map along z
          map_1d(spatial_cell, popID, intersection_x,intersection_x_di,intersection_x_dj,intersection_x_dk,0); // map along x
-         map_1d(spatial_cell, popID, intersection_y,intersection_y_di,intersection_y_dj,intersection_y_dk,1); // map along y
+         map_1d(spatial_cell, popID, intersection_y,intersection_y_di,intersection_y_dj,intersection_y_dk,1,momentSums); // map along y
          mappingTimer.stop();
          break;
       }
@@ -31,9 +31,39 @@
 using namespace std;
 using namespace spatial_cell;
 
-// Comparator function for sorting vector of pairs
-inline bool paircomparator( const std::pair<uint, uint> & l, const std::pair<uint, uint> & r ) {
-   return l.first < r.first;
+// Number of key bits handled per radix sort pass
+static const uint RADIX_BITS = 11;
+
+/*
+   Stable LSD radix sort of (key, value) pairs by key. All keys are known to be
+   at most maxKey, which is bounded by the size of the velocity grid, so only
+   as many passes as there are significant key bits are done. The temporary
+   buffer is reused between calls by the same thread.
+*/
+static void radixSortBlockPairs(std::vector<std::pair<vmesh::GlobalID,vmesh::GlobalID> >& pairs,
+                                const vmesh::GlobalID maxKey) {
+   static thread_local std::vector<std::pair<vmesh::GlobalID,vmesh::GlobalID> > buffer;
+   const size_t nPairs = pairs.size();
+   buffer.resize(nPairs);
+
+   const vmesh::GlobalID mask = (1u << RADIX_BITS) - 1;
+   std::vector<uint> bucketOffsets(mask + 1);
+   for (uint shift = 0; shift < 8 * sizeof(vmesh::GlobalID) && (maxKey >> shift) > 0; shift += RADIX_BITS) {
+      std::fill(bucketOffsets.begin(), bucketOffsets.end(), 0);
+      for (size_t i = 0; i < nPairs; ++i) {
+         ++bucketOffsets[(pairs[i].first >> shift) & mask];
+      }
+      uint offset = 0;
+      for (uint b = 0; b <= mask; ++b) {
+         const uint count = bucketOffsets[b];
+         bucketOffsets[b] = offset;
+         offset += count;
+      }
+      for (size_t i = 0; i < nPairs; ++i) {
+         buffer[bucketOffsets[(pairs[i].first >> shift) & mask]++] = pairs[i];
+      }
+      pairs.swap(buffer);
+   }
 }
 
 /*
@@ -117,8 +147,11 @@ void sortBlocklistByDimension( //const spatial_cell::SpatialCell* spatial_cell,
          break;
       }
    }
-   // Sort the list:
-   std::sort( block_pairs.begin(), block_pairs.end(), paircomparator );
+   // Sort the list. Mapped ids are bounded by the number of blocks in the velocity grid.
+   const vmesh::GlobalID maxMappedId = vmesh.getGridLength(REFLEVEL)[0]
+      * vmesh.getGridLength(REFLEVEL)[1]
+      * vmesh.getGridLength(REFLEVEL)[2] - 1;
+   radixSortBlockPairs(block_pairs, maxMappedId);
 
    // Put in the sorted blocks, and also compute column offsets and lengths:
    columnBlockOffsets.push_back(0); //first offset
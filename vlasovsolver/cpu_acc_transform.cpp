@@ -20,6 +20,9 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <iostream>
+#include <sstream>
+
 #include "../object_wrapper.h"
 #include "../sysboundary/ionosphere.h"
 
@@ -56,6 +59,74 @@ void updateAccelerationMaxdt(
 }
 
 
+/*!
+ Reference construction of the gyration transform: composes the small rotations of
+ each substep around the Hall-shifted bulk velocity, plus the electron pressure
+ gradient drift, one substep at a time.
+ * @param bulk_velocity Bulk velocity of the cell.
+ * @param hall Hall term, subtracted from the bulk velocity to get the rotation pivot.
+ * @param unit_B Unit vector along B, i.e., the rotation axis.
+ * @param gradPeDrift Velocity change per substep due to the electron pressure gradient.
+ * @param substeps_radians Rotation angle of one substep.
+ * @param bulk_velocity_substeps Number of substeps.
+*/
+static Transform<Real,3,Affine> iterativeGyrationTransform(
+   const Eigen::Matrix<Real,3,1>& bulk_velocity,
+   const Eigen::Matrix<Real,3,1>& hall,
+   const Eigen::Matrix<Real,3,1>& unit_B,
+   const Eigen::Matrix<Real,3,1>& gradPeDrift,
+   const Real substeps_radians,
+   const unsigned int bulk_velocity_substeps) {
+   Transform<Real,3,Affine> total_transform(Matrix<Real, 4, 4>::Identity());
+
+   for (uint i=0; i<bulk_velocity_substeps; ++i) {
+      // rotation origin is the point through which we place our rotation axis (direction of which is unitB).
+      // first add bulk velocity (using the total transform computed this far.
+      Eigen::Matrix<Real,3,1> rotation_pivot(total_transform*bulk_velocity);
+      
+      //include lorentzHallTerm (we should include, always)      
+      rotation_pivot -= hall;
+      
+      // add to transform matrix the small rotation around  pivot
+      // when added like this, and not using *= operator, the transformations
+      // are in the correct order
+      total_transform = Translation<Real,3>(-rotation_pivot)*total_transform;
+      total_transform = AngleAxis<Real>(substeps_radians,unit_B)*total_transform;
+      total_transform = Translation<Real,3>(rotation_pivot)*total_transform;
+
+      // Electron pressure gradient term
+      total_transform = Translation<Real,3>(gradPeDrift) * total_transform;
+   }
+   return total_transform;
+}
+
+/*!
+ Closed form of iterativeGyrationTransform. All substeps rotate around the same axis,
+ so after substep k the transform is x -> R^k x + c_k with R the substep rotation, and
+ c_{k+1} = R c_k + (I-R) p_k + a, where the pivot is p_k = R^k u + c_k - h. The c_k terms
+ cancel and the sum over R^k telescopes, giving
+ x -> R^N (x - u) + u - N (I-R) h + N a,
+ which is exactly what the N substeps produce, at the cost of a single step.
+ Parameters as in iterativeGyrationTransform.
+*/
+static Transform<Real,3,Affine> closedFormGyrationTransform(
+   const Eigen::Matrix<Real,3,1>& bulk_velocity,
+   const Eigen::Matrix<Real,3,1>& hall,
+   const Eigen::Matrix<Real,3,1>& unit_B,
+   const Eigen::Matrix<Real,3,1>& gradPeDrift,
+   const Real substeps_radians,
+   const unsigned int bulk_velocity_substeps) {
+   const Matrix<Real,3,3> substep_rotation = AngleAxis<Real>(substeps_radians,unit_B).toRotationMatrix();
+   const Eigen::Matrix<Real,3,1> drift
+      = Real(bulk_velocity_substeps) * (gradPeDrift - (Matrix<Real,3,3>::Identity() - substep_rotation) * hall);
+
+   Transform<Real,3,Affine> total_transform(Matrix<Real, 4, 4>::Identity());
+   total_transform = Translation<Real,3>(-bulk_velocity)*total_transform;
+   total_transform = AngleAxis<Real>(bulk_velocity_substeps*substeps_radians,unit_B)*total_transform;
+   total_transform = Translation<Real,3>(bulk_velocity + drift)*total_transform;
+   return total_transform;
+}
+
 /*!
  Compute transform during on timestep, and update the bulk velocity of the
  cell
@@ -111,9 +182,6 @@ Eigen::Transform<Real,3,Eigen::Affine> compute_acceleration_transformation(
                                          spatial_cell->parameters[CellParams::VY_V],
                                          spatial_cell->parameters[CellParams::VZ_V]);
 
-   // compute total transformation
-   Transform<Real,3,Affine> total_transform(Matrix<Real, 4, 4>::Identity()); //CONTINUE
-
    unsigned int bulk_velocity_substeps; // in this many substeps we iterate forward bulk velocity when the complete transformation is computed (0.1 deg per substep).
    bulk_velocity_substeps = fabs(dt) / fabs(gyro_period*(0.1/360.0));
    if (bulk_velocity_substeps < 1) bulk_velocity_substeps=1;
@@ -125,28 +193,43 @@ Eigen::Transform<Real,3,Eigen::Affine> compute_acceleration_transformation(
       spatial_cell->parameters[CellParams::EYGRADPE],
       spatial_cell->parameters[CellParams::EZGRADPE]);
 
-   for (uint i=0; i<bulk_velocity_substeps; ++i) {
-      // rotation origin is the point through which we place our rotation axis (direction of which is unitB).
-      // first add bulk velocity (using the total transform computed this far.
-      Eigen::Matrix<Real,3,1> rotation_pivot(total_transform*bulk_velocity);
-      
-      //include lorentzHallTerm (we should include, always)      
-      rotation_pivot[0]-= hallPrefactor*(dBZdy - dBYdz);
-      rotation_pivot[1]-= hallPrefactor*(dBXdz - dBZdx);
-      rotation_pivot[2]-= hallPrefactor*(dBYdx - dBXdy);
-      
-      // add to transform matrix the small rotation around  pivot
-      // when added like this, and not using *= operator, the transformations
-      // are in the correct order
-      total_transform = Translation<Real,3>(-rotation_pivot)*total_transform;
-      total_transform = AngleAxis<Real>(substeps_radians,unit_B)*total_transform;
-      total_transform = Translation<Real,3>(rotation_pivot)*total_transform;
+   //include lorentzHallTerm (we should include, always)
+   const Eigen::Matrix<Real,3,1> hall(hallPrefactor*(dBZdy - dBYdz),
+                                      hallPrefactor*(dBXdz - dBZdx),
+                                      hallPrefactor*(dBYdx - dBXdy));
 
-      // Electron pressure gradient term
-      if(Parameters::ohmGradPeTerm > 0) {
-         total_transform=Translation<Real,3>( (fabs(getObjectWrapper().particleSpecies[popID].charge)/getObjectWrapper().particleSpecies[popID].mass) * EgradPe * substeps_dt) * total_transform;
+   // Electron pressure gradient term, velocity change per substep
+   Eigen::Matrix<Real,3,1> gradPeDrift(0,0,0);
+   if(Parameters::ohmGradPeTerm > 0) {
+      gradPeDrift = (fabs(getObjectWrapper().particleSpecies[popID].charge)/getObjectWrapper().particleSpecies[popID].mass) * EgradPe * substeps_dt;
+   }
+
+   // compute total transformation
+   Transform<Real,3,Affine> total_transform;
+   if (P::vlasovIterativeAccelerationTransform) {
+      total_transform = iterativeGyrationTransform(bulk_velocity, hall, unit_B, gradPeDrift,
+                                                   substeps_radians, bulk_velocity_substeps);
+   } else {
+      total_transform = closedFormGyrationTransform(bulk_velocity, hall, unit_B, gradPeDrift,
+                                                    substeps_radians, bulk_velocity_substeps);
+   }
+
+   #ifdef DEBUG_ACC
+   {
+      const Transform<Real,3,Affine> reference_transform
+         = iterativeGyrationTransform(bulk_velocity, hall, unit_B, gradPeDrift,
+                                      substeps_radians, bulk_velocity_substeps);
+      const Real scale = 1.0 + bulk_velocity.norm() + hall.norm()
+         + bulk_velocity_substeps * gradPeDrift.norm();
+      const Real difference = (total_transform.matrix() - reference_transform.matrix()).cwiseAbs().maxCoeff();
+      if (difference > 1e-6 * scale) {
+         stringstream ss;
+         ss << "ERROR in acc transform: closed form differs from iterative by " << difference;
+         ss << " with " << bulk_velocity_substeps << " substeps" << endl;
+         cerr << ss.str();
       }
    }
+   #endif
 
    // If a bulk velocity is being forced here, perform that last, after things were gyrated in the Hall frame
    // If a cell is a remote L2 and was not caught in the loop over neighbours of L1 cells, compute its forcing here
@@ -20,14 +20,179 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <array>
 #include <phiprof.hpp>
 #include "cpu_moments.h"
+#include "vec.h"
 #include "../vlasovmover.h"
 #include "../object_wrapper.h"
 #include "../fieldsolver/fs_common.h" // divideIfNonZero()
 
 using namespace std;
 
+/** Locations of one set of velocity moments in CellParams and in Population.*/
+struct MomentVariables {
+   uint rhom, vx, vy, vz, rhoq, p11, p22, p33;
+   Real Population::*rho;
+   Real (Population::*v)[3];
+   Real (Population::*p)[3];
+};
+
+static const MomentVariables momentVariables = {
+   CellParams::RHOM, CellParams::VX, CellParams::VY, CellParams::VZ, CellParams::RHOQ,
+   CellParams::P_11, CellParams::P_22, CellParams::P_33,
+   &Population::RHO, &Population::V, &Population::P
+};
+
+static const MomentVariables momentVariables_R = {
+   CellParams::RHOM_R, CellParams::VX_R, CellParams::VY_R, CellParams::VZ_R, CellParams::RHOQ_R,
+   CellParams::P_11_R, CellParams::P_22_R, CellParams::P_33_R,
+   &Population::RHO_R, &Population::V_R, &Population::P_R
+};
+
+static const MomentVariables momentVariables_V = {
+   CellParams::RHOM_V, CellParams::VX_V, CellParams::VY_V, CellParams::VZ_V, CellParams::RHOQ_V,
+   CellParams::P_11_V, CellParams::P_22_V, CellParams::P_33_V,
+   &Population::RHO_V, &Population::V_V, &Population::P_V
+};
+
+/** Calculate velocity moments of all particle populations for the given spatial 
+ * cell, reading each velocity block only once. Second moments are accumulated 
+ * around the bulk velocity the cell had before this call, and shifted to the new 
+ * bulk velocity afterwards. This function is VAMR safe.
+ * @param cell Spatial cell.
+ * @param vars Variables where the moments are stored.
+ * @param computeFirst If true, zeroth and first moments are calculated. If false, 
+ * second moments are calculated around the existing bulk velocity of the cell.
+ * @param updateCell If true, moments summed over populations are stored in CellParams.
+ * @param computeSecond If true, second velocity moments are calculated.*/
+VEC_DISPATCH
+static void calculateCellMomentsSinglePass(spatial_cell::SpatialCell* cell,
+                                           const MomentVariables& vars,
+                                           const bool computeFirst,
+                                           const bool updateCell,
+                                           const bool computeSecond) {
+   if (computeFirst == false && computeSecond == false) return;
+
+   const uint nPopulations = getObjectWrapper().particleSpecies.size();
+   static thread_local std::vector<std::array<Real,7>> popSums;
+   popSums.resize(nPopulations);
+
+   // Reference velocity of the accumulated first and second moments
+   Real vRef[3] = {0.0, 0.0, 0.0};
+   if (computeSecond) {
+      vRef[0] = cell->parameters[vars.vx];
+      vRef[1] = cell->parameters[vars.vy];
+      vRef[2] = cell->parameters[vars.vz];
+   }
+
+   // Clear old moments to zero value
+   if (computeFirst && updateCell) {
+      cell->parameters[vars.rhom] = 0.0;
+      cell->parameters[vars.vx] = 0.0;
+      cell->parameters[vars.vy] = 0.0;
+      cell->parameters[vars.vz] = 0.0;
+      cell->parameters[vars.rhoq] = 0.0;
+      cell->parameters[vars.p11] = 0.0;
+      cell->parameters[vars.p22] = 0.0;
+      cell->parameters[vars.p33] = 0.0;
+   }
+
+   // Loop over all particle species
+   for (uint popID=0; popID<nPopulations; ++popID) {
+      vmesh::VelocityBlockContainer<vmesh::LocalID>& blockContainer = cell->get_velocity_blocks(popID);
+      if (blockContainer.size() == 0) continue;
+
+      const Realf* data       = blockContainer.getData();
+      const Real* blockParams = blockContainer.getParameters();
+      const Real mass = getObjectWrapper().particleSpecies[popID].mass;
+      const Real charge = getObjectWrapper().particleSpecies[popID].charge;
+
+      #ifdef DEBUG_MOMENTS
+      bool ok = true;
+      if (data == NULL && blockContainer.size() > 0) ok = false;
+      if (blockParams == NULL && blockContainer.size() > 0) ok = false;
+      if (ok == false) {
+         stringstream ss;
+         ss << "ERROR in moment calculation in " << __FILE__ << ":" << __LINE__ << endl;
+         ss << "\t &data = " << data << "\t &blockParams = " << blockParams << endl;
+         ss << "\t size = " << blockContainer.size() << endl;
+         cerr << ss.str();
+         exit(1);
+      }
+      #endif
+
+      // Species' moments, see blockVelocityMoments
+      std::array<Real,7>& array = popSums[popID];
+      array.fill(0.0);
+      for (vmesh::LocalID blockLID=0; blockLID<blockContainer.size(); ++blockLID) {
+         if (computeSecond) {
+            blockVelocityMoments(data+blockLID*WID3,
+                                 blockParams+blockLID*BlockParams::N_VELOCITY_BLOCK_PARAMS,
+                                 vRef,
+                                 array.data());
+         } else {
+            blockVelocityFirstMoments(data+blockLID*WID3,
+                                      blockParams+blockLID*BlockParams::N_VELOCITY_BLOCK_PARAMS,
+                                      array.data());
+         }
+      }
+
+      if (computeFirst == false) continue;
+
+      const Real nv[3] = {array[1] + vRef[0]*array[0],
+                          array[2] + vRef[1]*array[0],
+                          array[3] + vRef[2]*array[0]};
+
+      // Store species' contribution to bulk velocity moments
+      Population & pop = cell->get_population(popID);
+      pop.*vars.rho = array[0];
+      (pop.*vars.v)[0] = divideIfNonZero(nv[0], array[0]);
+      (pop.*vars.v)[1] = divideIfNonZero(nv[1], array[0]);
+      (pop.*vars.v)[2] = divideIfNonZero(nv[2], array[0]);
+
+      if (updateCell) {
+         cell->parameters[vars.rhom] += array[0]*mass;
+         cell->parameters[vars.vx] += nv[0]*mass;
+         cell->parameters[vars.vy] += nv[1]*mass;
+         cell->parameters[vars.vz] += nv[2]*mass;
+         cell->parameters[vars.rhoq] += array[0]*charge;
+      }
+   } // for-loop over particle species
+
+   if (computeFirst && updateCell) {
+      cell->parameters[vars.vx] = divideIfNonZero(cell->parameters[vars.vx], cell->parameters[vars.rhom]);
+      cell->parameters[vars.vy] = divideIfNonZero(cell->parameters[vars.vy], cell->parameters[vars.rhom]);
+      cell->parameters[vars.vz] = divideIfNonZero(cell->parameters[vars.vz], cell->parameters[vars.rhom]);
+   }
+
+   // Compute second moments only if requested
+   if (computeSecond == false) return;
+
+   // Shift from the reference velocity to the bulk velocity (over all species)
+   const Real shift[3] = {cell->parameters[vars.vx] - vRef[0],
+                          cell->parameters[vars.vy] - vRef[1],
+                          cell->parameters[vars.vz] - vRef[2]};
+
+   for (uint popID=0; popID<nPopulations; ++popID) {
+      if (cell->get_velocity_blocks(popID).size() == 0) continue;
+      const Real mass = getObjectWrapper().particleSpecies[popID].mass;
+      const std::array<Real,7>& array = popSums[popID];
+
+      // Store species' contribution to 2nd bulk velocity moments
+      Population & pop = cell->get_population(popID);
+      for (int d=0; d<3; ++d) {
+         (pop.*vars.p)[d] = mass*(array[4+d] - 2.0*shift[d]*array[1+d] + shift[d]*shift[d]*array[0]);
+      }
+
+      if (updateCell) {
+         cell->parameters[vars.p11] += (pop.*vars.p)[0];
+         cell->parameters[vars.p22] += (pop.*vars.p)[1];
+         cell->parameters[vars.p33] += (pop.*vars.p)[2];
+      }
+   } // for-loop over particle species
+}
+
 /** Calculate zeroth, first, and (possibly) second bulk velocity moments for the 
  * given spatial cell. The calculated moments include contributions from 
  * all existing particle populations. This function is VAMR safe.
@@ -46,101 +211,66 @@ void calculateCellMoments(spatial_cell::SpatialCell* cell,
        skipMoments = true;
    }
 
-   // Clear old moments to zero value
-   if (skipMoments == false && computePopulationMomentsOnly == false) {
-      cell->parameters[CellParams::RHOM  ] = 0.0;
-      cell->parameters[CellParams::VX] = 0.0;
-      cell->parameters[CellParams::VY] = 0.0;
-      cell->parameters[CellParams::VZ] = 0.0;
-      cell->parameters[CellParams::RHOQ  ] = 0.0;
-      cell->parameters[CellParams::P_11] = 0.0;
-      cell->parameters[CellParams::P_22] = 0.0;
-      cell->parameters[CellParams::P_33] = 0.0;
-   }
+   calculateCellMomentsSinglePass(cell, momentVariables, !skipMoments, !computePopulationMomentsOnly, computeSecond);
+}
 
-    // Loop over all particle species
-   if (skipMoments == false) {
-      for (uint popID=0; popID<getObjectWrapper().particleSpecies.size(); ++popID) {
-         vmesh::VelocityBlockContainer<vmesh::LocalID>& blockContainer = cell->get_velocity_blocks(popID);
-         if (blockContainer.size() == 0) continue;
-         
-         const Realf* data       = blockContainer.getData();
-         const Real* blockParams = blockContainer.getParameters();
-         const Real mass = getObjectWrapper().particleSpecies[popID].mass;
-         const Real charge = getObjectWrapper().particleSpecies[popID].charge;
-         
-         // Temporary array for storing moments
-         Real array[4];
-         for (int i=0; i<4; ++i) array[i] = 0.0;
-
-         // Calculate species' contribution to first velocity moments
-         for (vmesh::LocalID blockLID=0; blockLID<blockContainer.size(); ++blockLID) {
-            blockVelocityFirstMoments(data+blockLID*WID3,
-                                      blockParams+blockLID*BlockParams::N_VELOCITY_BLOCK_PARAMS,
-                                      array);
-         }
-         
-         Population & pop = cell->get_population(popID);
-         pop.RHO = array[0];
-         pop.V[0] = divideIfNonZero(array[1], array[0]);
-         pop.V[1] = divideIfNonZero(array[2], array[0]);
-         pop.V[2] = divideIfNonZero(array[3], array[0]);
-         
-         if(!computePopulationMomentsOnly) {
-            // Store species' contribution to bulk velocity moments
-            cell->parameters[CellParams::RHOM  ] += array[0]*mass;
-            cell->parameters[CellParams::VX] += array[1]*mass;
-            cell->parameters[CellParams::VY] += array[2]*mass;
-            cell->parameters[CellParams::VZ] += array[3]*mass;
-            cell->parameters[CellParams::RHOQ  ] += array[0]*charge;
-         }
-      } // for-loop over particle species
-      
-      if(!computePopulationMomentsOnly) {
-         cell->parameters[CellParams::VX] = divideIfNonZero(cell->parameters[CellParams::VX], cell->parameters[CellParams::RHOM]);
-         cell->parameters[CellParams::VY] = divideIfNonZero(cell->parameters[CellParams::VY], cell->parameters[CellParams::RHOM]);
-         cell->parameters[CellParams::VZ] = divideIfNonZero(cell->parameters[CellParams::VZ], cell->parameters[CellParams::RHOM]);
-      }
+/** Calculate zeroth and first bulk velocity moments for the given spatial cell,
+ * including contributions from all existing particle populations. Same as the
+ * first moment part of calculateMoments_V, for a single cell. The calculated
+ * moments are stored to SpatialCell::parameters in _V variables.
+ * This function is VAMR safe.
+ * @param cell Spatial cell.*/
+void calculateCellMoments_V(spatial_cell::SpatialCell* cell) {
+   if (cell->sysBoundaryFlag == sysboundarytype::DO_NOT_COMPUTE) {
+      return;
    }
+   calculateCellMomentsSinglePass(cell, momentVariables_V, true, true, false);
+}
 
-    // Compute second moments only if requested
-   if (computeSecond == false) return;
-    
-   // Loop over all particle species
-   for (uint popID=0; popID<getObjectWrapper().particleSpecies.size(); ++popID) {
-      vmesh::VelocityBlockContainer<vmesh::LocalID>& blockContainer = cell->get_velocity_blocks(popID);
-      if (blockContainer.size() == 0) continue;
-      
-      const Realf* data       = blockContainer.getData();
-      const Real* blockParams = blockContainer.getParameters();
-      const Real mass = getObjectWrapper().particleSpecies[popID].mass;
-      
-      // Temporary array for storing moments
-      Real array[3];
-      for (int i=0; i<3; ++i) array[i] = 0.0;
+/** Store zeroth and first velocity moments of one particle population, which were 
+ * accumulated elsewhere (e.g. by map_1d), and update the _V moments of the cell. 
+ * The other populations are not read again, their existing _V moments are used. 
+ * The result is the same as with calculateCellMoments_V, as long as the moments 
+ * of the other populations are up to date.
+ * @param cell Spatial cell.
+ * @param popID ID of the population whose moments were accumulated.
+ * @param popSums Sums n, n*vx, n*vy, n*vz of the population, see blockVelocityFirstMoments.*/
+void storeCellMoments_V(spatial_cell::SpatialCell* cell, const uint popID, const Real* popSums) {
+   if (cell->sysBoundaryFlag == sysboundarytype::DO_NOT_COMPUTE) {
+      return;
+   }
+   const MomentVariables& vars = momentVariables_V;
 
-      // Calculate species' contribution to second velocity moments
+   if (cell->get_velocity_blocks(popID).size() > 0) {
       Population & pop = cell->get_population(popID);
-      for (vmesh::LocalID blockLID=0; blockLID<blockContainer.size(); ++blockLID) {
-         blockVelocitySecondMoments(data+blockLID*WID3,
-                                    blockParams+blockLID*BlockParams::N_VELOCITY_BLOCK_PARAMS,
-                                    cell->parameters[CellParams::VX],
-                                    cell->parameters[CellParams::VY],
-                                    cell->parameters[CellParams::VZ],
-                                    array);
-      }
-      
-      // Store species' contribution to bulk velocity moments
-      pop.P[0] = mass*array[0];
-      pop.P[1] = mass*array[1];
-      pop.P[2] = mass*array[2];
-      
-      if(!computePopulationMomentsOnly) {
-         cell->parameters[CellParams::P_11] += pop.P[0];
-         cell->parameters[CellParams::P_22] += pop.P[1];
-         cell->parameters[CellParams::P_33] += pop.P[2];
+      pop.*vars.rho = popSums[0];
+      (pop.*vars.v)[0] = divideIfNonZero(popSums[1], popSums[0]);
+      (pop.*vars.v)[1] = divideIfNonZero(popSums[2], popSums[0]);
+      (pop.*vars.v)[2] = divideIfNonZero(popSums[3], popSums[0]);
+   }
+
+   Real rhom = 0.0, rhoq = 0.0;
+   Real mv[3] = {0.0, 0.0, 0.0};
+   for (uint p=0; p<getObjectWrapper().particleSpecies.size(); ++p) {
+      if (cell->get_velocity_blocks(p).size() == 0) continue;
+      const Real mass = getObjectWrapper().particleSpecies[p].mass;
+      const Real charge = getObjectWrapper().particleSpecies[p].charge;
+      const Population & pop = cell->get_population(p);
+      rhom += pop.*vars.rho*mass;
+      rhoq += pop.*vars.rho*charge;
+      for (int d=0; d<3; ++d) {
+         mv[d] += (pop.*vars.v)[d]*(pop.*vars.rho)*mass;
       }
-   } // for-loop over particle species
+   }
+
+   cell->parameters[vars.rhom] = rhom;
+   cell->parameters[vars.vx] = divideIfNonZero(mv[0], rhom);
+   cell->parameters[vars.vy] = divideIfNonZero(mv[1], rhom);
+   cell->parameters[vars.vz] = divideIfNonZero(mv[2], rhom);
+   cell->parameters[vars.rhoq] = rhoq;
+   cell->parameters[vars.p11] = 0.0;
+   cell->parameters[vars.p22] = 0.0;
+   cell->parameters[vars.p33] = 0.0;
 }
 
 /** Calculate zeroth, first, and (possibly) second bulk velocity moments for the 
@@ -155,138 +285,20 @@ void calculateMoments_R(
         const std::vector<CellID>& cells,
         const bool& computeSecond) {
  
-    phiprof::Timer momentsTimer {"compute-moments-n"};
-
-    for (uint popID=0; popID<getObjectWrapper().particleSpecies.size(); ++popID) {
-       #pragma omp parallel for
-       for (size_t c=0; c<cells.size(); ++c) {
-          SpatialCell* cell = mpiGrid[cells[c]];
-          
-          if (cell->sysBoundaryFlag == sysboundarytype::DO_NOT_COMPUTE) {
-             continue;
-          }
-          
-          // Clear old moments to zero value
-          if (popID == 0) {
-             cell->parameters[CellParams::RHOM_R  ] = 0.0;
-             cell->parameters[CellParams::VX_R] = 0.0;
-             cell->parameters[CellParams::VY_R] = 0.0;
-             cell->parameters[CellParams::VZ_R] = 0.0;
-             cell->parameters[CellParams::RHOQ_R  ] = 0.0;
-             cell->parameters[CellParams::P_11_R] = 0.0;
-             cell->parameters[CellParams::P_22_R] = 0.0;
-             cell->parameters[CellParams::P_33_R] = 0.0;
-          }
-
-          vmesh::VelocityBlockContainer<vmesh::LocalID>& blockContainer = cell->get_velocity_blocks(popID);
-          if (blockContainer.size() == 0) continue;
-          const Realf* data       = blockContainer.getData();
-          const Real* blockParams = blockContainer.getParameters();
-          const Real mass = getObjectWrapper().particleSpecies[popID].mass;
-          const Real charge = getObjectWrapper().particleSpecies[popID].charge;
-
-          #ifdef DEBUG_MOMENTS
-          bool ok = true;
-          if (data == NULL && blockContainer.size() > 0) ok = false;
-          if (blockParams == NULL && blockContainer.size() > 0) ok = false;
-          if (ok == false) {
-             stringstream ss;
-             ss << "ERROR in moment calculation in " << __FILE__ << ":" << __LINE__ << endl;
-             ss << "\t &data = " << data << "\t &blockParams = " << blockParams << endl;
-             ss << "\t size = " << blockContainer.size() << endl;
-             cerr << ss.str();
-             exit(1);
-          }
-          #endif
-
-          // Temporary array where the moments for this species are accumulated
-          Real array[4];
-          for (int i=0; i<4; ++i) array[i] = 0.0;
-
-          // Calculate species' contribution to first velocity moments
-          for (vmesh::LocalID blockLID=0; blockLID<blockContainer.size(); ++blockLID) {
-            blockVelocityFirstMoments(data+blockLID*WID3,
-                                      blockParams+blockLID*BlockParams::N_VELOCITY_BLOCK_PARAMS,
-                                      array);
-          } // for-loop over velocity blocks
-
-          // Store species' contribution to bulk velocity moments
-          Population & pop = cell->get_population(popID);
-          pop.RHO_R = array[0];
-          pop.V_R[0] = divideIfNonZero(array[1], array[0]);
-          pop.V_R[1] = divideIfNonZero(array[2], array[0]);
-          pop.V_R[2] = divideIfNonZero(array[3], array[0]);
-          
-          cell->parameters[CellParams::RHOM_R  ] += array[0]*mass;
-          cell->parameters[CellParams::VX_R] += array[1]*mass;
-          cell->parameters[CellParams::VY_R] += array[2]*mass;
-          cell->parameters[CellParams::VZ_R] += array[3]*mass;
-          cell->parameters[CellParams::RHOQ_R  ] += array[0]*charge;
-       } // for-loop over spatial cells
-    } // for-loop over particle species
-    
-    #pragma omp parallel for
-    for (size_t c=0; c<cells.size(); ++c) {
-       SpatialCell* cell = mpiGrid[cells[c]];
-       if (cell->sysBoundaryFlag == sysboundarytype::DO_NOT_COMPUTE) {
-          continue;
-       }
-       cell->parameters[CellParams::VX_R] = divideIfNonZero(cell->parameters[CellParams::VX_R], cell->parameters[CellParams::RHOM_R]);
-       cell->parameters[CellParams::VY_R] = divideIfNonZero(cell->parameters[CellParams::VY_R], cell->parameters[CellParams::RHOM_R]);
-       cell->parameters[CellParams::VZ_R] = divideIfNonZero(cell->parameters[CellParams::VZ_R], cell->parameters[CellParams::RHOM_R]);
-    }
-
-   // Compute second moments only if requested.
-   if (computeSecond == false) {
-      return;
-   }
-
-   for (uint popID=0; popID<getObjectWrapper().particleSpecies.size(); ++popID) {
-      #pragma omp parallel for
-      for (size_t c=0; c<cells.size(); ++c) {
-         SpatialCell* cell = mpiGrid[cells[c]];
-         
-         if (cell->sysBoundaryFlag == sysboundarytype::DO_NOT_COMPUTE) {
-            continue;
-         }
-         
-         vmesh::VelocityBlockContainer<vmesh::LocalID>& blockContainer = cell->get_velocity_blocks(popID);
-         if (blockContainer.size() == 0) continue;
-         const Realf* data       = blockContainer.getData();
-         const Real* blockParams = blockContainer.getParameters();
-         const Real mass = getObjectWrapper().particleSpecies[popID].mass;
-
-         // Temporary array where species' contribution to 2nd moments is accumulated
-         Real array[3];
-         for (int i=0; i<3; ++i) array[i] = 0.0;
-
-         // Calculate species' contribution to second velocity moments
-         Population & pop = cell->get_population(popID);
-         for (vmesh::LocalID blockLID=0; blockLID<blockContainer.size(); ++blockLID) {
-            blockVelocitySecondMoments(data+blockLID*WID3,
-                                       blockParams+blockLID*BlockParams::N_VELOCITY_BLOCK_PARAMS,
-                                       cell->parameters[CellParams::VX_R],
-                                       cell->parameters[CellParams::VY_R],
-                                       cell->parameters[CellParams::VZ_R],
-                                       array);
-         } // for-loop over velocity blocks
-
-         // Store species' contribution to 2nd bulk velocity moments
-         pop.P_R[0] = mass*array[0];
-         pop.P_R[1] = mass*array[1];
-         pop.P_R[2] = mass*array[2];
-         
-         cell->parameters[CellParams::P_11_R] += pop.P_R[0];
-         cell->parameters[CellParams::P_22_R] += pop.P_R[1];
-         cell->parameters[CellParams::P_33_R] += pop.P_R[2];
-      } // for-loop over spatial cells
-   } // for-loop over particle species
+   phiprof::Timer momentsTimer {"compute-moments-n"};
 
+   #pragma omp parallel for schedule(dynamic)
+   for (size_t c=0; c<cells.size(); ++c) {
+      SpatialCell* cell = mpiGrid[cells[c]];
+      if (cell->sysBoundaryFlag == sysboundarytype::DO_NOT_COMPUTE) {
+         continue;
+      }
+      calculateCellMomentsSinglePass(cell, momentVariables_R, true, true, computeSecond);
+   }
 }
 
 /** Calculate zeroth, first, and (possibly) second bulk velocity moments for the 
- * given spatial cell. Additionally, for each species, calculate the maximum 
- * spatial time step so that CFL(spatial)=1. The calculated moments include 
+ * given spatial cell. The calculated moments include 
  * contributions from all existing particle populations. The calculated moments 
  * are stored to SpatialCell::parameters in _V variables. This function is VAMR safe.
  * @param mpiGrid Parallel grid library.
@@ -298,118 +310,13 @@ void calculateMoments_V(
         const bool& computeSecond) {
  
    phiprof::Timer momentsTimer {"Compute _V moments"};
-   
-   // Loop over all particle species
-   for (uint popID=0; popID<getObjectWrapper().particleSpecies.size(); ++popID) {
-      #pragma omp parallel for
-      for (size_t c=0; c<cells.size(); ++c) {
-         SpatialCell* cell = mpiGrid[cells[c]];
-         
-         if (cell->sysBoundaryFlag == sysboundarytype::DO_NOT_COMPUTE) {
-            continue;
-         }
-         
-         // Clear old moments to zero value
-         if (popID == 0) {
-             cell->parameters[CellParams::RHOM_V  ] = 0.0;
-             cell->parameters[CellParams::VX_V] = 0.0;
-             cell->parameters[CellParams::VY_V] = 0.0;
-             cell->parameters[CellParams::VZ_V] = 0.0;
-             cell->parameters[CellParams::RHOQ_V  ] = 0.0;
-             cell->parameters[CellParams::P_11_V] = 0.0;
-             cell->parameters[CellParams::P_22_V] = 0.0;
-             cell->parameters[CellParams::P_33_V] = 0.0;
-         }
-
-         vmesh::VelocityBlockContainer<vmesh::LocalID>& blockContainer = cell->get_velocity_blocks(popID);
-         if (blockContainer.size() == 0) continue;
-         const Realf* data       = blockContainer.getData();
-         const Real* blockParams = blockContainer.getParameters();
-         const Real mass = getObjectWrapper().particleSpecies[popID].mass;
-         const Real charge = getObjectWrapper().particleSpecies[popID].charge;
 
-         // Temporary array for storing moments
-         Real array[4];
-         for (int i=0; i<4; ++i) array[i] = 0.0;
-
-         // Calculate species' contribution to first velocity moments
-         for (vmesh::LocalID blockLID=0; blockLID<blockContainer.size(); ++blockLID) {
-            blockVelocityFirstMoments(data+blockLID*WID3,
-                                      blockParams+blockLID*BlockParams::N_VELOCITY_BLOCK_PARAMS,
-                                      array);
-         }
-         
-         // Store species' contribution to bulk velocity moments
-         Population & pop = cell->get_population(popID);
-         pop.RHO_V = array[0];
-         pop.V_V[0] = divideIfNonZero(array[1], array[0]);
-         pop.V_V[1] = divideIfNonZero(array[2], array[0]);
-         pop.V_V[2] = divideIfNonZero(array[3], array[0]);
-         
-         cell->parameters[CellParams::RHOM_V  ] += array[0]*mass;
-         cell->parameters[CellParams::VX_V] += array[1]*mass;
-         cell->parameters[CellParams::VY_V] += array[2]*mass;
-         cell->parameters[CellParams::VZ_V] += array[3]*mass;
-         cell->parameters[CellParams::RHOQ_V  ] += array[0]*charge;
-      } // for-loop over spatial cells
-   } // for-loop over particle species
-   
-   #pragma omp parallel for
+   #pragma omp parallel for schedule(dynamic)
    for (size_t c=0; c<cells.size(); ++c) {
       SpatialCell* cell = mpiGrid[cells[c]];
       if (cell->sysBoundaryFlag == sysboundarytype::DO_NOT_COMPUTE) {
          continue;
       }
-      cell->parameters[CellParams::VX_V] = divideIfNonZero(cell->parameters[CellParams::VX_V], cell->parameters[CellParams::RHOM_V]);
-      cell->parameters[CellParams::VY_V] = divideIfNonZero(cell->parameters[CellParams::VY_V], cell->parameters[CellParams::RHOM_V]);
-      cell->parameters[CellParams::VZ_V] = divideIfNonZero(cell->parameters[CellParams::VZ_V], cell->parameters[CellParams::RHOM_V]);
+      calculateCellMomentsSinglePass(cell, momentVariables_V, true, true, computeSecond);
    }
-
-   // Compute second moments only if requested
-   if (computeSecond == false) {
-      return;
-   }
-
-   for (uint popID=0; popID<getObjectWrapper().particleSpecies.size(); ++popID) {
-      #pragma omp parallel for
-      for (size_t c=0; c<cells.size(); ++c) {
-         SpatialCell* cell = mpiGrid[cells[c]];
-         
-         if (cell->sysBoundaryFlag == sysboundarytype::DO_NOT_COMPUTE) {
-            continue;
-         }
-
-         vmesh::VelocityBlockContainer<vmesh::LocalID>& blockContainer = cell->get_velocity_blocks(popID);
-         if (blockContainer.size() == 0) continue;
-         const Realf* data       = blockContainer.getData();
-         const Real* blockParams = blockContainer.getParameters();
-         const Real mass = getObjectWrapper().particleSpecies[popID].mass;
-
-         // Temporary array where moments are stored
-         Real array[3];
-         for (int i=0; i<3; ++i) array[i] = 0.0;
-
-         // Calculate species' contribution to second velocity moments
-         Population & pop = cell->get_population(popID);
-         for (vmesh::LocalID blockLID=0; blockLID<blockContainer.size(); ++blockLID) {
-            blockVelocitySecondMoments(
-                                       data+blockLID*WID3,
-                                       blockParams+blockLID*BlockParams::N_VELOCITY_BLOCK_PARAMS,
-                                       cell->parameters[CellParams::VX_V],
-                                       cell->parameters[CellParams::VY_V],
-                                       cell->parameters[CellParams::VZ_V],
-                                       array);
-         } // for-loop over velocity blocks
-         
-         // Store species' contribution to 2nd bulk velocity moments
-         pop.P_V[0] = mass*array[0];
-         pop.P_V[1] = mass*array[1];
-         pop.P_V[2] = mass*array[2];
-         
-         cell->parameters[CellParams::P_11_V] += pop.P_V[0];
-         cell->parameters[CellParams::P_22_V] += pop.P_V[1];
-         cell->parameters[CellParams::P_33_V] += pop.P_V[2];
-         
-      } // for-loop over spatial cells
-   } // for-loop over particle species
 }
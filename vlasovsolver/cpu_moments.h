@@ -45,6 +45,11 @@ void blockVelocitySecondMoments(const Realf* avgs,const Real* blockParams,
                                 const REAL v[3],
                                 REAL* array);
 
+template<typename REAL> 
+void blockVelocityMoments(const Realf* avgs,const Real* blockParams,
+                          const REAL vRef[3],
+                          REAL* array);
+
 void calculateMoments_R(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
                               const std::vector<CellID>& cells,
                               const bool& computeSecond);
@@ -53,6 +58,10 @@ void calculateMoments_V(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpi
                         const std::vector<CellID>& cells,
                         const bool& computeSecond);
 
+void calculateCellMoments_V(SpatialCell* cell);
+
+void storeCellMoments_V(SpatialCell* cell, const uint popID, const Real* popSums);
+
 
 
 // ***** TEMPLATE FUNCTION DEFINITIONS ***** //
@@ -137,4 +146,60 @@ void blockVelocitySecondMoments(
    array[2] += nvz2_sum * DV3;
 }
 
+/** Calculate the zeroth, first and second velocity moments for the given velocity 
+ * block in a single pass, and add results to 'array', which must have at least 
+ * size seven. The moments are taken around the reference velocity vRef. After 
+ * this function returns, the contents of 'array' are as follows: array[0]=n; 
+ * array[1]=n(Vx-VxRef); array[2]=n(Vy-VyRef); array[3]=n(Vz-VzRef); 
+ * array[4]=n(Vx-VxRef)^2; array[5]=n(Vy-VyRef)^2; array[6]=n(Vz-VzRef)^2. 
+ * The closer vRef is to the bulk velocity, the smaller the cancellation when 
+ * the second moments are shifted to it. This function is VAMR safe.
+ * @param avgs Distribution function.
+ * @param blockParams Parameters for the given velocity block.
+ * @param vRef Reference velocity.
+ * @param array Array of at least size seven where the calculated moments are added.*/
+template<typename REAL> inline
+void blockVelocityMoments(
+        const Realf* avgs,
+        const Real* blockParams,
+        const REAL vRef[3],
+        REAL* array) {
+
+   const Real HALF = 0.5;
+
+   Real n_sum = 0.0;
+   Real nvx_sum = 0.0;
+   Real nvy_sum = 0.0;
+   Real nvz_sum = 0.0;
+   Real nvx2_sum = 0.0;
+   Real nvy2_sum = 0.0;
+   Real nvz2_sum = 0.0;
+   for (uint k=0; k<WID; ++k) for (uint j=0; j<WID; ++j) {
+      const Real VY = blockParams[BlockParams::VYCRD] + (j+HALF)*blockParams[BlockParams::DVY] - vRef[1];
+      const Real VZ = blockParams[BlockParams::VZCRD] + (k+HALF)*blockParams[BlockParams::DVZ] - vRef[2];
+      #pragma omp simd reduction(+:n_sum,nvx_sum,nvy_sum,nvz_sum,nvx2_sum,nvy2_sum,nvz2_sum)
+      for (uint i=0; i<WID; ++i) {
+         const Real VX = blockParams[BlockParams::VXCRD] + (i+HALF)*blockParams[BlockParams::DVX] - vRef[0];
+         const Real f = avgs[cellIndex(i,j,k)];
+
+         n_sum    += f;
+         nvx_sum  += f*VX;
+         nvy_sum  += f*VY;
+         nvz_sum  += f*VZ;
+         nvx2_sum += f*VX*VX;
+         nvy2_sum += f*VY*VY;
+         nvz2_sum += f*VZ*VZ;
+      }
+   }
+   
+   const Real DV3 = blockParams[BlockParams::DVX]*blockParams[BlockParams::DVY]*blockParams[BlockParams::DVZ];
+   array[0] += n_sum    * DV3;
+   array[1] += nvx_sum  * DV3;
+   array[2] += nvy_sum  * DV3;
+   array[3] += nvz_sum  * DV3;
+   array[4] += nvx2_sum * DV3;
+   array[5] += nvy2_sum * DV3;
+   array[6] += nvz2_sum * DV3;
+}
+
 #endif
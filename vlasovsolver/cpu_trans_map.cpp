@@ -30,11 +30,10 @@
 
 #include "../grid.h"
 #include "../object_wrapper.h"
+#include "../telemetry.h"
 #include "vec.h"
-#include "cpu_1d_plm.hpp"
-#include "cpu_1d_ppm.hpp"
 #include "cpu_1d_ppm_nonuniform.hpp"
-#include "cpu_1d_pqm.hpp"
+#include "cpu_1d_reconstruction.hpp"
 #include "cpu_trans_map.hpp"
 
 using namespace std;
@@ -309,6 +308,55 @@ void copy_trans_block_data(
    }
 }
 
+/*
+   Translate the data of one velocity block, read with its stencil into values, into
+   targetVecValues using the reconstruction ORDER. Templated on the order so that
+   the reconstruction is resolved at compile time, trans_map_1d dispatches once per block.
+*/
+template<reconstruction::Order ORDER>
+static inline void translateBlock(Vec * const values, Vec * const targetVecValues,
+                                  const velocity_block_indices_t& block_indices, const uint dimension,
+                                  const Realv dvz, const Realv vz_min, const Realv dt, const Realv i_dz,
+                                  const Realv minValue) {
+   //i,j,k are now relative to the order in which we copied data to the values array. 
+   //After this point in the k,j,i loops there should be no branches based on dimensions
+   //
+   //Note that the i dimension is vectorized, and thus there are no loops over i
+   for (uint k=0; k<WID; ++k) {
+      const Realv cell_vz = (block_indices[dimension] * WID + k + 0.5) * dvz + vz_min; //cell centered velocity
+      const Realv z_translation = cell_vz * dt * i_dz; // how much it moved in time dt (reduced units)
+      const int target_scell_index = (z_translation > 0) ? 1: -1; //part of density goes here (cell index change along spatial direcion)
+    
+      //the coordinates (scaled units from 0 to 1) between which we will
+      //integrate to put mass in the target  neighboring cell. 
+      //As we are below CFL<1, we know
+      //that mass will go to two cells: current and the new one.
+      Realv z_1,z_2;
+      if ( z_translation < 0 ) {
+         z_1 = 0;
+         z_2 = -z_translation; 
+      } else {
+         z_1 = 1.0 - z_translation;
+         z_2 = 1.0;
+      }
+      
+      for (uint planeVector = 0; planeVector < VEC_PER_PLANE; planeVector++) {
+         //compute reconstruction
+         Vec a[5];
+         //Check that stencil width VLASOV_STENCIL_WIDTH in grid.h corresponds to order of face estimates  (h4 & h5 =2, H6=3, h8=4),
+         //this is checked against the selected reconstruction when reading the parameters
+         compute_reconstruction_coeff<ORDER>(values + i_trans_ps_blockv(planeVector, k, -VLASOV_STENCIL_WIDTH), VLASOV_STENCIL_WIDTH,
+                                          h4, h6, a, minValue);
+ 
+         const Vec ngbr_target_density =
+            integrate_reconstruction<ORDER>(a, Vec(z_2)) -
+            integrate_reconstruction<ORDER>(a, Vec(z_1));
+         targetVecValues[i_trans_pt_blockv(planeVector, k, target_scell_index)] +=  ngbr_target_density;                     //in the current original cells we will put this density        
+         targetVecValues[i_trans_pt_blockv(planeVector, k, 0)] +=  values[i_trans_ps_blockv(planeVector, k, 0)] - ngbr_target_density; //in the current original cells we will put the rest of the original density
+      }
+   }
+}
+
 /* 
    Here we map from the current time step grid, to a target grid which
    is the lagrangian departure grid (so th grid at timestep +dt,
@@ -486,64 +534,25 @@ bool trans_map_1d(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpi
             velocity_block_indices_t block_indices;
             uint8_t refLevel;
             vmesh.getIndices(blockGID,refLevel, block_indices[0], block_indices[1], block_indices[2]);
+
+            // Reconstruction for this block, adaptive mode uses PQM only if the stencil has significant values
+            const reconstruction::Order blockOrder =
+               select_reconstruction_order(P::vlasovTranslationReconstruction,
+                                           values, (1 + 2 * VLASOV_STENCIL_WIDTH) * WID3 / VECL,
+                                           P::vlasovAdaptiveReconstructionThreshold * spatial_cell->getVelocityBlockMinValue(popID));
           
-            //i,j,k are now relative to the order in which we copied data to the values array. 
-            //After this point in the k,j,i loops there should be no branches based on dimensions
-            //
-            //Note that the i dimension is vectorized, and thus there are no loops over i
-            for (uint k=0; k<WID; ++k) {
-               const Realv cell_vz = (block_indices[dimension] * WID + k + 0.5) * dvz + vz_min; //cell centered velocity
-               const Realv z_translation = cell_vz * dt * i_dz; // how much it moved in time dt (reduced units)
-               const int target_scell_index = (z_translation > 0) ? 1: -1; //part of density goes here (cell index change along spatial direcion)
-             
-               //the coordinates (scaled units from 0 to 1) between which we will
-               //integrate to put mass in the target  neighboring cell. 
-               //As we are below CFL<1, we know
-               //that mass will go to two cells: current and the new one.
-               Realv z_1,z_2;
-               if ( z_translation < 0 ) {
-                  z_1 = 0;
-                  z_2 = -z_translation; 
-               } else {
-                  z_1 = 1.0 - z_translation;
-                  z_2 = 1.0;
-               }
-               
-               for (uint planeVector = 0; planeVector < VEC_PER_PLANE; planeVector++) {
-                  //compute reconstruction
-#ifdef TRANS_SEMILAG_PLM
-                  Vec a[3];
-                  compute_plm_coeff(values + i_trans_ps_blockv(planeVector, k, -VLASOV_STENCIL_WIDTH), VLASOV_STENCIL_WIDTH, a, spatial_cell->getVelocityBlockMinValue(popID));
-#endif
-#ifdef TRANS_SEMILAG_PPM
-                  Vec a[3];
-                  //Check that stencil width VLASOV_STENCIL_WIDTH in grid.h corresponds to order of face estimates  (h4 & h5 =2, H6=3, h8=4)
-                  compute_ppm_coeff(values + i_trans_ps_blockv(planeVector, k, -VLASOV_STENCIL_WIDTH), h4, VLASOV_STENCIL_WIDTH, a, spatial_cell->getVelocityBlockMinValue(popID));
-#endif
-#ifdef TRANS_SEMILAG_PQM
-                  Vec a[5];
-                  //Check that stencil width VLASOV_STENCIL_WIDTH in grid.h corresponds to order of face estimates (h4 & h5 =2, H6=3, h8=4)
-                  compute_pqm_coeff(values + i_trans_ps_blockv(planeVector, k, -VLASOV_STENCIL_WIDTH), h6, VLASOV_STENCIL_WIDTH, a, spatial_cell->getVelocityBlockMinValue(popID));
-#endif
-          
-#ifdef TRANS_SEMILAG_PLM
-                  const Vec ngbr_target_density =
-                     z_2 * ( a[0] + z_2 * a[1] ) -
-                     z_1 * ( a[0] + z_1 * a[1] );
-#endif
-#ifdef TRANS_SEMILAG_PPM
-                  const Vec ngbr_target_density =
-                     z_2 * ( a[0] + z_2 * ( a[1] + z_2 * a[2] ) ) -
-                     z_1 * ( a[0] + z_1 * ( a[1] + z_1 * a[2] ) );
-#endif
-#ifdef TRANS_SEMILAG_PQM
-                  const Vec ngbr_target_density =
-                     z_2 * ( a[0] + z_2 * ( a[1] + z_2 * ( a[2] + z_2 * ( a[3] + z_2 * a[4] ) ) ) ) -
-                     z_1 * ( a[0] + z_1 * ( a[1] + z_1 * ( a[2] + z_1 * ( a[3] + z_1 * a[4] ) ) ) );
-#endif
-                  targetVecValues[i_trans_pt_blockv(planeVector, k, target_scell_index)] +=  ngbr_target_density;                     //in the current original cells we will put this density        
-                  targetVecValues[i_trans_pt_blockv(planeVector, k, 0)] +=  values[i_trans_ps_blockv(planeVector, k, 0)] - ngbr_target_density; //in the current original cells we will put the rest of the original density
-               }
+            // Dispatch once per block to the kernel compiled for the reconstruction order
+            const Realv minValue = spatial_cell->getVelocityBlockMinValue(popID);
+            switch (blockOrder) {
+            case reconstruction::PLM:
+               translateBlock<reconstruction::PLM>(values, targetVecValues, block_indices, dimension, dvz, vz_min, dt, i_dz, minValue);
+               break;
+            case reconstruction::PPM:
+               translateBlock<reconstruction::PPM>(values, targetVecValues, block_indices, dimension, dvz, vz_min, dt, i_dz, minValue);
+               break;
+            default:
+               translateBlock<reconstruction::PQM>(values, targetVecValues, block_indices, dimension, dvz, vz_min, dt, i_dz, minValue);
+               break;
             }
          
             //Store final vector data in temporary data for all target blocks,
@@ -727,6 +736,7 @@ void update_remote_mapping_contribution(
    // Do communication
    SpatialCell::setCommunicatedSpecies(popID);
    SpatialCell::set_mpi_transfer_type(Transfer::NEIGHBOR_VEL_BLOCK_DATA);
+   telemetry::PhaseTimer updatePhase {telemetry::MPI_WAIT};
    switch(dimension) {
    case 0:
       if(direction > 0) mpiGrid.update_copies_of_remote_neighbors(SHIFT_P_X_NEIGHBORHOOD_ID);
@@ -741,6 +751,7 @@ void update_remote_mapping_contribution(
       if(direction < 0) mpiGrid.update_copies_of_remote_neighbors(SHIFT_M_Z_NEIGHBORHOOD_ID);
       break;
    }
+   updatePhase.stop();
    
 #pragma omp parallel
    {
@@ -1,9 +1,11 @@
 #include "cpu_1d_ppm_nonuniform.hpp"
 //#include "cpu_1d_ppm_nonuniform_conserving.hpp"
 #include "vec.h"
+#include "../common.h"
 #include "../grid.h"
 #include "../object_wrapper.h"
 #include "../memoryallocation.h"
+#include "../telemetry.h"
 #include "cpu_trans_map_amr.hpp"
 #include "cpu_trans_map.hpp"
 
@@ -712,6 +714,7 @@ bool check_skip_remapping(Vec* values) {
  * @param vmesh Velocity mesh object
  * @param lengthOfPencil Number of cells in the pencil
  */
+VEC_DISPATCH
 void propagatePencil(
    Vec* dz,
    Vec* values,
@@ -1382,6 +1385,107 @@ void prepareSeedIdsAndPencils(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Ge
    buildPencilsTimer.stop();
 }
 
+/* Split the pencils of one dimension into those that do not depend on the ghost cell data of the
+ * given neighborhood, and can thus be mapped while that data is still being transferred, and those
+ * that have to wait for it.
+ *
+ * A pencil depends on the transfer if any of its source or target cells is a remote cell, or a local
+ * cell whose data is being sent to other processes. Pencils are mapped in-place, so pencils sharing
+ * a cell (at refinement interfaces) have to be mapped together. The dependency is therefore
+ * propagated to all pencils connected through shared cells.
+ *
+ * @param [in] mpiGrid DCCRG grid object
+ * @param [in] remoteTargetCells List of non-local target cells
+ * @param [in] dimension Spatial dimension
+ * @param [in] neighborhood Neighborhood used for transferring the ghost cell data
+ * @param [out] interiorPencils Pencils that can be mapped before the transfer has completed
+ * @param [out] boundaryPencils Pencils that can only be mapped after the transfer has completed
+ */
+void splitPencilsByHaloDependence(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+                                  const vector<CellID>& remoteTargetCells,
+                                  const uint dimension,
+                                  const int neighborhood,
+                                  vector<uint>& interiorPencils,
+                                  vector<uint>& boundaryPencils) {
+   setOfPencils& pencils = DimensionPencils[dimension];
+   interiorPencils.clear();
+   boundaryPencils.clear();
+
+   // Cells whose data is sent or received in the ghost transfer
+   std::unordered_set<const SpatialCell*> haloCells;
+   for (const CellID id : mpiGrid.get_remote_cells_on_process_boundary(neighborhood)) {
+      haloCells.insert(mpiGrid[id]);
+   }
+   for (const CellID id : mpiGrid.get_local_cells_on_process_boundary(neighborhood)) {
+      haloCells.insert(mpiGrid[id]);
+   }
+   for (const CellID id : remoteTargetCells) {
+      haloCells.insert(mpiGrid[id]);
+   }
+
+   const uint nTargetNeighborsPerPencil = 1;
+   std::vector<SpatialCell*> targetCells(pencils.sumOfLengths + pencils.N * 2 * nTargetNeighborsPerPencil);
+   computeSpatialTargetCellsForPencilsWithFaces(mpiGrid, pencils, dimension, targetCells.data());
+
+   // Union-find over pencils, joining pencils which share a cell
+   std::vector<uint> root(pencils.N);
+   for (uint pencili = 0; pencili < pencils.N; ++pencili) {
+      root[pencili] = pencili;
+   }
+   auto findRoot = [&root](uint pencili) {
+      while (root[pencili] != pencili) {
+         root[pencili] = root[root[pencili]];
+         pencili = root[pencili];
+      }
+      return pencili;
+   };
+
+   std::vector<bool> dependsOnHalo(pencils.N, false);
+   std::unordered_map<const SpatialCell*,uint> cellPencil;
+   auto addCell = [&](const SpatialCell* cell, const uint pencili) {
+      if (cell == NULL) {
+         return;
+      }
+      if (haloCells.count(cell) > 0) {
+         dependsOnHalo[pencili] = true;
+      }
+      const auto it = cellPencil.find(cell);
+      if (it == cellPencil.end()) {
+         cellPencil[cell] = pencili;
+      } else {
+         root[findRoot(pencili)] = findRoot(it->second);
+      }
+   };
+
+   uint targetOffset = 0;
+   for (uint pencili = 0; pencili < pencils.N; ++pencili) {
+      const uint L = pencils.lengthOfPencils[pencili];
+      std::vector<SpatialCell*> sourceCells(L + 2 * VLASOV_STENCIL_WIDTH);
+      computeSpatialSourceCellsForPencil(mpiGrid, pencils, pencili, dimension, sourceCells.data());
+      for (const SpatialCell* cell : sourceCells) {
+         addCell(cell, pencili);
+      }
+      for (uint celli = 0; celli < L + 2 * nTargetNeighborsPerPencil; ++celli) {
+         addCell(targetCells[targetOffset + celli], pencili);
+      }
+      targetOffset += L + 2 * nTargetNeighborsPerPencil;
+   }
+
+   std::vector<bool> setDependsOnHalo(pencils.N, false);
+   for (uint pencili = 0; pencili < pencils.N; ++pencili) {
+      if (dependsOnHalo[pencili]) {
+         setDependsOnHalo[findRoot(pencili)] = true;
+      }
+   }
+   for (uint pencili = 0; pencili < pencils.N; ++pencili) {
+      if (setDependsOnHalo[findRoot(pencili)]) {
+         boundaryPencils.push_back(pencili);
+      } else {
+         interiorPencils.push_back(pencili);
+      }
+   }
+}
+
 /* Map velocity blocks in all local cells forward by one time step in one spatial dimension.
  * This function uses 1-cell wide pencils to update cells in-place to avoid allocating large
  * temporary buffers.
@@ -1390,9 +1494,11 @@ void prepareSeedIdsAndPencils(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Ge
  * @param [in] localPropagatedCells List of local cells that get propagated
  * ie. not boundary or DO_NOT_COMPUTE
  * @param [in] remoteTargetCells List of non-local target cells
+ * @param [in,out] nPencils Number of pencils through each propagated cell, accumulated if preparing for rebalance
  * @param [in] dimension Spatial dimension
  * @param [in] dt Time step
  * @param [in] popId Particle population ID
+ * @param [in] pencilIds Pencils to map. Pencils sharing cells must be mapped in the same call.
  */
 bool trans_map_1d_amr(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
                       const vector<CellID>& localPropagatedCells,
@@ -1400,7 +1506,8 @@ bool trans_map_1d_amr(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
                       std::vector<uint>& nPencils,
                       const uint dimension,
                       const Realv dt,
-                      const uint popID) {
+                      const uint popID,
+                      const std::vector<uint>& pencilIds) {
    phiprof::Timer setupTimer {"setup"};
    uint cell_indices_to_id[3]; /*< used when computing id of target cell in block*/
    unsigned char  cellid_transpose[WID3]; /*< defines the transpose for the solver internal (transposed) id: i + j*WID + k*WID2 to actual one*/
@@ -1478,12 +1585,24 @@ bool trans_map_1d_amr(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
    // }
    
    if (Parameters::prepareForRebalance == true) {
+      std::unordered_map<CellID,uint> propagatedCellIndex;
       for (uint i=0; i<localPropagatedCells.size(); i++) {
-         cuint myPencilCount = std::count(DimensionPencils[dimension].ids.begin(), DimensionPencils[dimension].ids.end(), localPropagatedCells[i]);
-         nPencils[i] += myPencilCount;
-         nPencils[nPencils.size()-1] += myPencilCount;
+         propagatedCellIndex[localPropagatedCells[i]] = i;
+      }
+      for (const uint pencili : pencilIds) {
+         for (const CellID id : DimensionPencils[dimension].getIds(pencili)) {
+            const auto it = propagatedCellIndex.find(id);
+            if (it != propagatedCellIndex.end()) {
+               nPencils[it->second]++;
+               nPencils[nPencils.size()-1]++;
+            }
+         }
       }
    }
+
+   if (pencilIds.size() == 0) {
+      return true;
+   }
    
    // Get a pointer to the velocity mesh of the first spatial cell
    const vmesh::VelocityMesh<vmesh::GlobalID,vmesh::LocalID>& vmesh = allCellsPointer[0]->get_velocity_mesh(popID);
@@ -1530,7 +1649,35 @@ bool trans_map_1d_amr(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
    phiprof::Timer computeTargetsTimer {"computeSpatialTargetCellsForPencils"};
    std::vector<SpatialCell*> targetCells(DimensionPencils[dimension].sumOfLengths + DimensionPencils[dimension].N * 2 * nTargetNeighborsPerPencil );
    computeSpatialTargetCellsForPencilsWithFaces(mpiGrid, DimensionPencils[dimension], dimension, targetCells.data());
+
+   // Offsets of the pencils in targetCells and targetBlockData
+   std::vector<uint> targetOffsets(DimensionPencils[dimension].N);
+   uint totalTargetLength = 0;
+   for(uint pencili = 0; pencili < DimensionPencils[dimension].N; ++pencili) {
+      targetOffsets[pencili] = totalTargetLength;
+      totalTargetLength += DimensionPencils[dimension].lengthOfPencils[pencili] + 2 * nTargetNeighborsPerPencil;
+   }
    computeTargetsTimer.stop();
+
+   // Compute spatial neighbors for the source cells of the mapped pencils. In
+   // source cells we have a wider stencil and take into account boundaries.
+   // These are only read in the mapping loop, so all threads share them.
+   phiprof::Timer computeSourcesTimer {"computeSpatialSourceCellsForPencils"};
+   std::vector<std::vector<SpatialCell*>> pencilSourceCells(pencilIds.size());
+   std::vector<std::vector<Vec, aligned_allocator<Vec,WID3>>> pencildz(pencilIds.size());
+   #pragma omp parallel for schedule(dynamic)
+   for(uint i = 0; i < pencilIds.size(); ++i) {
+      cuint sourceLength = DimensionPencils[dimension].lengthOfPencils[pencilIds[i]] + 2 * VLASOV_STENCIL_WIDTH;
+      pencilSourceCells[i].resize(sourceLength);
+      computeSpatialSourceCellsForPencil(mpiGrid, DimensionPencils[dimension], pencilIds[i], dimension, pencilSourceCells[i].data());
+
+      // dz is the cell size in the direction of the pencil
+      pencildz[i].resize(sourceLength);
+      for(uint j = 0; j < sourceLength; ++j) {
+         pencildz[i][j] = pencilSourceCells[i][j]->parameters[CellParams::DX+dimension];
+      }
+   }
+   computeSourcesTimer.stop();
    
    setupTimer.stop();
    
@@ -1540,15 +1687,13 @@ bool trans_map_1d_amr(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
    #pragma omp parallel
    {
       // declarations for variables needed by the threads
-      std::vector<Realf, aligned_allocator<Realf, WID3>> targetBlockData((DimensionPencils[dimension].sumOfLengths + 2 * nTargetNeighborsPerPencil * DimensionPencils[dimension].N) * WID3);
-      std::vector<std::vector<SpatialCell*>> pencilSourceCells;
+      std::vector<Realf, aligned_allocator<Realf, WID3>> targetBlockData(totalTargetLength * WID3);
       
       // Allocate aligned vectors which are needed once per pencil to avoid reallocating once per block loop + pencil loop iteration
       std::vector<std::vector<Vec, aligned_allocator<Vec,WID3>>> pencilTargetValues;
       std::vector<std::vector<Vec, aligned_allocator<Vec,WID3>>> pencilSourceVecData;
-      std::vector<std::vector<Vec, aligned_allocator<Vec,WID3>>> pencildz;
       
-      for(uint pencili = 0; pencili < DimensionPencils[dimension].N; ++pencili) {
+      for(const uint pencili : pencilIds) {
          
          cint L = DimensionPencils[dimension].lengthOfPencils[pencili];
          cuint sourceLength = L + 2 * VLASOV_STENCIL_WIDTH;
@@ -1560,19 +1705,6 @@ bool trans_map_1d_amr(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
          // Add padding by 2 * VLASOV_STENCIL_WIDTH
          std::vector<Vec, aligned_allocator<Vec,WID3>> sourceVecData(sourceLength * WID3 / VECL);
          pencilSourceVecData.push_back(sourceVecData);
-
-         // Compute spatial neighbors for the source cells of the pencil. In
-         // source cells we have a wider stencil and take into account boundaries.
-         std::vector<SpatialCell*> sourceCells(sourceLength);
-         computeSpatialSourceCellsForPencil(mpiGrid, DimensionPencils[dimension], pencili, dimension, sourceCells.data());
-         pencilSourceCells.push_back(sourceCells);
-
-         // dz is the cell size in the direction of the pencil
-         std::vector<Vec, aligned_allocator<Vec,WID3>> dz(sourceLength);
-         for(uint i = 0; i < sourceCells.size(); ++i) {
-            dz[i] = sourceCells[i]->parameters[CellParams::DX+dimension];
-         }
-         pencildz.push_back(dz);
       }
       
       // Loop over velocity space blocks. Thread this loop (over vspace blocks) with OpenMP.
@@ -1585,25 +1717,23 @@ bool trans_map_1d_amr(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
             phiprof::Timer mappingTimer {mappingId};
             
             // Loop over pencils
-            uint totalTargetLength = 0;
-            for(uint pencili = 0; pencili < DimensionPencils[dimension].N; ++pencili){
-//             for ( auto pencili : unionOfBlocksMapToPencilIds.at(blockGID) ) {
+            for(uint i = 0; i < pencilIds.size(); ++i){
                
+               const uint pencili = pencilIds[i];
                int L = DimensionPencils[dimension].lengthOfPencils[pencili];
                uint targetLength = L + 2 * nTargetNeighborsPerPencil;
                               
                // load data(=> sourcedata) / (proper xy reconstruction in future)
-               bool pencil_has_data = copy_trans_block_data_amr(pencilSourceCells[pencili].data(), blockGID, L, pencilSourceVecData[pencili].data(),
+               bool pencil_has_data = copy_trans_block_data_amr(pencilSourceCells[i].data(), blockGID, L, pencilSourceVecData[i].data(),
                                          cellid_transpose, popID);
 
                if(!pencil_has_data) {
-                  totalTargetLength += targetLength;
                   continue;
                }
 
                // Dz and sourceVecData are both padded by VLASOV_STENCIL_WIDTH
                // Dz has 1 value/cell, sourceVecData has WID3 values/cell
-               propagatePencil(pencildz[pencili].data(), pencilSourceVecData[pencili].data(), pencilTargetValues[pencili].data(), dimension, blockGID, dt, vmesh, L, pencilSourceCells[pencili][0]->getVelocityBlockMinValue(popID));
+               propagatePencil(pencildz[i].data(), pencilSourceVecData[i].data(), pencilTargetValues[i].data(), dimension, blockGID, dt, vmesh, L, pencilSourceCells[i][0]->getVelocityBlockMinValue(popID));
 
                // sourceVecData => targetBlockData[this pencil])
 
@@ -1617,20 +1747,19 @@ bool trans_map_1d_amr(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
                         // Unpack the vector data
                         Realf vector[VECL];
                         //pencilSourceVecData[pencili][i_trans_ps_blockv_pencil(planeVector, k, icell - 1, L)].store(vector);
-                        pencilTargetValues[pencili][i_trans_pt_blockv(planeVector, k, icell - 1)].store(vector);
+                        pencilTargetValues[i][i_trans_pt_blockv(planeVector, k, icell - 1)].store(vector);
 
                         // Loop over 3rd (vectorized) vspace dimension
                         for (uint iv = 0; iv < VECL; iv++) {
 
                            // Store vector data in target data array.
-                           targetBlockData[(totalTargetLength + icell) * WID3 +
+                           targetBlockData[(targetOffsets[pencili] + icell) * WID3 +
                                            cellid_transpose[iv + planeVector * VECL + k * WID2]]
                               = vector[iv];
                         }
                      }
                   }
                }
-               totalTargetLength += targetLength;
                
             } // Closes loop over pencils. SourceVecData gets implicitly deallocated here.
 
@@ -1638,24 +1767,29 @@ bool trans_map_1d_amr(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
             phiprof::Timer storeTimer {storeId};
             
             // reset blocks in all non-sysboundary neighbor spatial cells for this block id
-            // At this point the block data is saved in targetBlockData so we can reset the spatial cells
+            // At this point the block data is saved in targetBlockData so we can reset the spatial cells.
+            // Pencils sharing target cells are always mapped in the same call, see splitPencilsByHaloDependence.
 
-            for (auto *spatial_cell: targetCells) {
-               // Check for null and system boundary
-               if (spatial_cell && spatial_cell->sysBoundaryFlag == sysboundarytype::NOT_SYSBOUNDARY) {
-                  
-                  // Get local velocity block id
-                  const vmesh::LocalID blockLID = spatial_cell->get_velocity_block_local_id(blockGID, popID);
-                  
-                  // Check for invalid block id
-                  if (blockLID != vmesh::VelocityMesh<vmesh::GlobalID,vmesh::LocalID>::invalidLocalID()) {
+            for(const uint pencili : pencilIds) {
+               uint targetLength = DimensionPencils[dimension].lengthOfPencils[pencili] + 2 * nTargetNeighborsPerPencil;
+               for ( uint celli = 0; celli < targetLength; celli++ ) {
+                  SpatialCell* spatial_cell = targetCells[targetOffsets[pencili] + celli];
+                  // Check for null and system boundary
+                  if (spatial_cell && spatial_cell->sysBoundaryFlag == sysboundarytype::NOT_SYSBOUNDARY) {
                      
-                     // Get a pointer to the block data
-                     Realf* blockData = spatial_cell->get_data(blockLID, popID);
+                     // Get local velocity block id
+                     const vmesh::LocalID blockLID = spatial_cell->get_velocity_block_local_id(blockGID, popID);
                      
-                     // Loop over velocity block cells
-                     for(int i = 0; i < WID3; i++) {
-                        blockData[i] = 0.0;
+                     // Check for invalid block id
+                     if (blockLID != vmesh::VelocityMesh<vmesh::GlobalID,vmesh::LocalID>::invalidLocalID()) {
+                        
+                        // Get a pointer to the block data
+                        Realf* blockData = spatial_cell->get_data(blockLID, popID);
+                        
+                        // Loop over velocity block cells
+                        for(int i = 0; i < WID3; i++) {
+                           blockData[i] = 0.0;
+                        }
                      }
                   }
                }
@@ -1663,8 +1797,7 @@ bool trans_map_1d_amr(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
 
             // store_data(target_data => targetCells)  :Aggregate data for blockid to original location 
             // Loop over pencils again
-            totalTargetLength = 0;
-            for(uint pencili = 0; pencili < DimensionPencils[dimension].N; pencili++){
+            for(const uint pencili : pencilIds) {
                
                uint targetLength = DimensionPencils[dimension].lengthOfPencils[pencili] + 2 * nTargetNeighborsPerPencil;
                
@@ -1672,7 +1805,7 @@ bool trans_map_1d_amr(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
                // Loop over cells in the pencil, including the padded cells of the target array
                for ( uint celli = 0; celli < targetLength; celli++ ) {
                   
-                  uint GID = celli + totalTargetLength; 
+                  uint GID = celli + targetOffsets[pencili]; 
                   SpatialCell* targetCell = targetCells[GID];
 
                   if(targetCell) { // this check also skips sysboundary cells
@@ -1703,8 +1836,6 @@ bool trans_map_1d_amr(const dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
                      }
                   }
                }
-
-               totalTargetLength += targetLength;
                
             } // closes loop over pencils
 
@@ -2013,14 +2144,17 @@ void update_remote_mapping_contribution_amr(
       
    } // closes for (auto c : local_cells) {
 
-   MPI_Barrier(MPI_COMM_WORLD);
+   addTimedBarrier("barrier-trans-pre-update_remote");
    
-   // Do communication
+   // Do communication. The point-to-point neighbor exchange is all the
+   // synchronization needed, each process only waits for its own neighbors.
    SpatialCell::setCommunicatedSpecies(popID);
    SpatialCell::set_mpi_transfer_type(Transfer::NEIGHBOR_VEL_BLOCK_DATA);
+   telemetry::PhaseTimer updatePhase {telemetry::MPI_WAIT};
    mpiGrid.update_copies_of_remote_neighbors(neighborhood);
+   updatePhase.stop();
 
-   MPI_Barrier(MPI_COMM_WORLD);
+   addTimedBarrier("barrier-trans-post-update_remote");
    
    // Reduce data: sum received data in the data array to 
    // the target grid in the temporary block container   
@@ -193,7 +193,15 @@ bool trans_map_1d_amr(const dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartes
                   std::vector<uint>& nPencils,
                   const uint dimension,
                   const Realv dt,
-                  const uint popID);
+                  const uint popID,
+                  const std::vector<uint>& pencilIds);
+
+void splitPencilsByHaloDependence(const dccrg::Dccrg<spatial_cell::SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+                                  const std::vector<CellID>& remoteTargetCells,
+                                  const uint dimension,
+                                  const int neighborhood,
+                                  std::vector<uint>& interiorPencils,
+                                  std::vector<uint>& boundaryPencils);
 
 void update_remote_mapping_contribution_amr(dccrg::Dccrg<spatial_cell::SpatialCell,
                                             dccrg::Cartesian_Geometry>& mpiGrid,
@@ -49,6 +49,19 @@ VEC8F_AGNER
  - Vector length of 8
  - Use Agner's vectorclass with AVX intrinisics
 
+The Agner backends are tied to the instruction set given at compile time
+(-march, -mavx2...). To run one binary on nodes with different instruction
+sets, use a *_FALLBACK backend, a generic -march, and define
+VEC_RUNTIME_DISPATCH. The hot kernels marked with VEC_DISPATCH (map_1d,
+propagatePencil including the inlined PPM/PQM reconstructions, and the
+moment loops) are then compiled for the x86-64-v4 (AVX-512) and
+x86-64-v3 (AVX2, FMA) microarchitecture levels and the baseline, and the
+highest level supported by the CPU is picked at startup via CPUID. The
+clones are selected by ISA features, not CPU model, so e.g. AMD Zen and
+newer Intel parts get the AVX2/AVX-512 versions. Compilers without
+target_clones support for the levels (GCC < 12, Clang) clone on the
+avx512f and avx2 features instead.
+The vector length VECL and the precision stay compile-time choices.
  
 */
 
@@ -190,6 +203,32 @@ typedef float Realv;
 #endif
 
 
+#ifdef VEC_RUNTIME_DISPATCH
+#if defined(VEC4D_AGNER) || defined(VEC8D_AGNER) || defined(VEC4F_AGNER) || defined(VEC8F_AGNER) || defined(VEC16F_AGNER)
+#error "VEC_RUNTIME_DISPATCH requires a *_FALLBACK vector backend, Agner's vectorclass fixes the instruction set at compile time"
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+// VEC_DISPATCH_HIGH and VEC_DISPATCH_MID are also valid __builtin_cpu_supports names,
+// so the clone picked at startup can be reported with the same checks as the resolver
+#if __GNUC__ >= 12 && !defined(__clang__)
+#define VEC_DISPATCH_HIGH "x86-64-v4"
+#define VEC_DISPATCH_MID "x86-64-v3"
+#define VEC_DISPATCH __attribute__((target_clones("arch=" VEC_DISPATCH_HIGH,"arch=" VEC_DISPATCH_MID,"default")))
+#else
+#define VEC_DISPATCH_HIGH "avx512f"
+#define VEC_DISPATCH_MID "avx2"
+#define VEC_DISPATCH __attribute__((target_clones(VEC_DISPATCH_HIGH,VEC_DISPATCH_MID,"default")))
+#endif
+#endif
+#endif
+#ifndef VEC_DISPATCH
+#define VEC_DISPATCH
+#define VEC_DISPATCH_INLINE inline
+#else
+// Helpers of VEC_DISPATCH kernels are forced inline so that each clone gets them compiled for its instruction set
+#define VEC_DISPATCH_INLINE inline __attribute__((always_inline))
+#endif
+
 const Vec one(1.0);
 const Vec minus_one(-1.0);
 const Vec two(2.0);
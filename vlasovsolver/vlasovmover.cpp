@@ -20,8 +20,10 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
+#include <utility>
 #include <vector>
 #include <stdint.h>
 
@@ -32,12 +34,14 @@
 #include <dccrg.hpp>
 #include <phiprof.hpp>
 
+#include "../common.h"
 #include "../spatial_cell.hpp"
 #include "../vlasovmover.h"
 #include "../grid.h"
 #include "../definitions.h"
 #include "../object_wrapper.h"
 #include "../mpiconversion.h"
+#include "../telemetry.h"
 
 #include "cpu_moments.h"
 #include "cpu_acc_semilag.hpp"
@@ -55,172 +59,190 @@ creal ONE     = 1.0;
 creal TWO     = 2.0;
 creal EPSILON = 1.0e-25;
 
-/** Propagates the distribution function in spatial space. 
-    
-    Based on SLICE-3D algorithm: Zerroukat, M., and T. Allen. "A
-    three‐dimensional monotone and conservative semi‐Lagrangian scheme
-    (SLICE‐3D) for transport problems." Quarterly Journal of the Royal
-    Meteorological Society 138.667 (2012): 1640-1651.
-  
+/** Start the transfer of the ghost cell data of one population, which is
+    needed for translation along one dimension. With
+    P::vlasovPackedGhostTransfers the data is packed first, and the sizes of
+    the packed data are exchanged before the transfer is started.
  */
-void calculateSpatialTranslation(
+static void startGhostDataTransfer(
+        dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+        const uint popID,
+        const uint dimension,
+        const int neighborhood
+) {
+   const bool AMRtranslationActive = (P::amrMaxSpatialRefLevel > 0);
+   SpatialCell::setCommunicatedSpecies(popID);
+   SpatialCell::set_mpi_transfer_direction(dimension);
+   if (P::vlasovPackedGhostTransfers) {
+      const vector<CellID> localCells = mpiGrid.get_local_cells_on_process_boundary(neighborhood);
+      #pragma omp parallel for schedule(dynamic)
+      for (size_t c=0; c<localCells.size(); ++c) {
+         mpiGrid[localCells[c]]->pack_velocity_block_data(popID);
+      }
+      SpatialCell::set_mpi_transfer_type(Transfer::VEL_BLOCK_DATA_PACKED_SIZE,false,AMRtranslationActive);
+      mpiGrid.update_copies_of_remote_neighbors(neighborhood);
+      SpatialCell::set_mpi_transfer_type(Transfer::VEL_BLOCK_DATA_PACKED,false,AMRtranslationActive);
+   } else {
+      SpatialCell::set_mpi_transfer_type(Transfer::VEL_BLOCK_DATA,false,AMRtranslationActive);
+   }
+   mpiGrid.start_remote_neighbor_copy_updates(neighborhood);
+}
+
+/** Wait for the ghost cell data transfer started by startGhostDataTransfer,
+    and unpack the received data if it was packed. The packed buffers of the
+    sent and received cells are released afterwards.
+ */
+static void waitGhostDataTransfer(
+        dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+        const uint popID,
+        const int neighborhood
+) {
+   telemetry::PhaseTimer waitPhase {telemetry::MPI_WAIT};
+   mpiGrid.wait_remote_neighbor_copy_updates(neighborhood);
+   waitPhase.stop();
+   if (P::vlasovPackedGhostTransfers) {
+      const vector<CellID> remoteCells = mpiGrid.get_remote_cells_on_process_boundary(neighborhood);
+      #pragma omp parallel for schedule(dynamic)
+      for (size_t c=0; c<remoteCells.size(); ++c) {
+         mpiGrid[remoteCells[c]]->unpack_velocity_block_data(popID);
+      }
+      const vector<CellID> localCells = mpiGrid.get_local_cells_on_process_boundary(neighborhood);
+      #pragma omp parallel for schedule(dynamic)
+      for (size_t c=0; c<localCells.size(); ++c) {
+         mpiGrid[localCells[c]]->release_packed_block_data();
+      }
+   }
+}
+
+/** Translates all populations along one dimension.
+
+    The populations are pipelined: the ghost cell data transfer of the
+    next population is started as soon as that of the current one has
+    arrived, so that it is in flight while the current population is
+    mapped and its remote contributions are exchanged. On AMR grids the
+    pencils which do not depend on the ghost data are in addition mapped
+    before waiting for it.
+ */
+static void translateDimension(
         dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
-        const vector<CellID>& localCells,
         const vector<CellID>& local_propagated_cells,
-        const vector<CellID>& local_target_cells,
-        const vector<CellID>& remoteTargetCellsx,
-        const vector<CellID>& remoteTargetCellsy,
-        const vector<CellID>& remoteTargetCellsz,
+        const vector<CellID>& remoteTargetCells,
         vector<uint>& nPencils,
+        const uint dimension,
         creal dt,
-        const uint popID,
         Real &time
 ) {
+   const bool AMRtranslationActive = (P::amrMaxSpatialRefLevel > 0);
+   const string dimName = string(1, "xyz"[dimension]);
+   const uint nPopulations = getObjectWrapper().particleSpecies.size();
+
+   // update_remote_mapping_contribution_amr communicates in the solver
+   // neighborhood, so on AMR grids the ghost data in flight meanwhile uses
+   // a copy of it.
+   const int solverNeighborhoods[3] = {VLASOV_SOLVER_X_NEIGHBORHOOD_ID,
+                                       VLASOV_SOLVER_Y_NEIGHBORHOOD_ID,
+                                       VLASOV_SOLVER_Z_NEIGHBORHOOD_ID};
+   const int ghostNeighborhoods[3] = {VLASOV_SOLVER_GHOST_X_NEIGHBORHOOD_ID,
+                                      VLASOV_SOLVER_GHOST_Y_NEIGHBORHOOD_ID,
+                                      VLASOV_SOLVER_GHOST_Z_NEIGHBORHOOD_ID};
+   const int neighborhood = AMRtranslationActive ? ghostNeighborhoods[dimension] : solverNeighborhoods[dimension];
+
+   vector<uint> interiorPencils;
+   vector<uint> boundaryPencils;
+   if (AMRtranslationActive) {
+      phiprof::Timer splitTimer {"split-pencils-"+dimName};
+      splitPencilsByHaloDependence(mpiGrid, remoteTargetCells, dimension, neighborhood, interiorPencils, boundaryPencils);
+   }
 
-    bool AMRtranslationActive = false;
-    if (P::amrMaxSpatialRefLevel > 0) AMRtranslationActive = true;
+   phiprof::Timer transTimer {"transfer-stencil-data-"+dimName, {"MPI"}};
+   startGhostDataTransfer(mpiGrid, 0, dimension, neighborhood);
+   transTimer.stop();
 
-    double t1;
-    
-    int myRank;
-    MPI_Comm_rank(MPI_COMM_WORLD,&myRank);
-   
-   phiprof::Timer btzTimer {"barrier-trans-pre-z", {"Barriers","MPI"}};
-   MPI_Barrier(MPI_COMM_WORLD);
-   btzTimer.stop();
- 
-    // ------------- SLICE - map dist function in Z --------------- //
-   if(P::zcells_ini > 1){
-
-      phiprof::Timer transTimer {"transfer-stencil-data-z", {"MPI"}};
-      //updateRemoteVelocityBlockLists(mpiGrid,popID,VLASOV_SOLVER_Z_NEIGHBORHOOD_ID);
-      SpatialCell::set_mpi_transfer_direction(2);
-      SpatialCell::set_mpi_transfer_type(Transfer::VEL_BLOCK_DATA,false,AMRtranslationActive);
-      mpiGrid.update_copies_of_remote_neighbors(VLASOV_SOLVER_Z_NEIGHBORHOOD_ID);
-      transTimer.stop();
+   for (uint popID=0; popID<nPopulations; ++popID) {
+      phiprof::Timer timer {"translate "+getObjectWrapper().particleSpecies[popID].name};
+      double t1;
+
+      if (AMRtranslationActive) {
+         t1 = MPI_Wtime();
+         phiprof::Timer interiorTimer {"compute-mapping-interior-"+dimName};
+         trans_map_1d_amr(mpiGrid, local_propagated_cells, remoteTargetCells, nPencils, dimension, dt, popID, interiorPencils);
+         interiorTimer.stop();
+         time += MPI_Wtime() - t1;
+      }
 
-      // bt=phiprof::initializeTimer("barrier-trans-pre-trans_map_1d-z","Barriers","MPI");
-      // phiprof::start(bt);
-      // MPI_Barrier(MPI_COMM_WORLD);
-      // phiprof::stop(bt);
+      phiprof::Timer waitTimer {"wait-stencil-data-"+dimName, {"MPI"}};
+      waitGhostDataTransfer(mpiGrid, popID, neighborhood);
+      waitTimer.stop();
+
+      // Ghost data of the next population is transferred while this one is mapped
+      if (popID + 1 < nPopulations) {
+         phiprof::Timer transTimer {"transfer-stencil-data-"+dimName, {"MPI"}};
+         startGhostDataTransfer(mpiGrid, popID + 1, dimension, neighborhood);
+      }
 
       t1 = MPI_Wtime();
-      phiprof::Timer computeTimer {"compute-mapping-z"};
-      if(P::amrMaxSpatialRefLevel == 0) {
-         trans_map_1d(mpiGrid,local_propagated_cells, remoteTargetCellsz, 2, dt,popID); // map along z//
+      phiprof::Timer computeTimer {"compute-mapping-"+dimName};
+      if (AMRtranslationActive) {
+         trans_map_1d_amr(mpiGrid, local_propagated_cells, remoteTargetCells, nPencils, dimension, dt, popID, boundaryPencils);
       } else {
-         trans_map_1d_amr(mpiGrid,local_propagated_cells, remoteTargetCellsz, nPencils, 2, dt,popID); // map along z//
+         trans_map_1d(mpiGrid, local_propagated_cells, remoteTargetCells, dimension, dt, popID);
       }
       computeTimer.stop();
       time += MPI_Wtime() - t1;
 
-      phiprof::Timer btTimer {"barrier-trans-pre-update_remote-z", {"Barriers","MPI"}};
-      MPI_Barrier(MPI_COMM_WORLD);
-      btTimer.stop();
-
-      phiprof::Timer updateRemoteTimer {"update_remote-z", {"MPI"}};
-      if(P::amrMaxSpatialRefLevel == 0) {
-         update_remote_mapping_contribution(mpiGrid, 2,+1,popID);
-         update_remote_mapping_contribution(mpiGrid, 2,-1,popID);
+      phiprof::Timer updateRemoteTimer {"update_remote-"+dimName, {"MPI"}};
+      if (AMRtranslationActive) {
+         update_remote_mapping_contribution_amr(mpiGrid, dimension,+1,popID);
+         update_remote_mapping_contribution_amr(mpiGrid, dimension,-1,popID);
       } else {
-         update_remote_mapping_contribution_amr(mpiGrid, 2,+1,popID);
-         update_remote_mapping_contribution_amr(mpiGrid, 2,-1,popID);
+         update_remote_mapping_contribution(mpiGrid, dimension,+1,popID);
+         update_remote_mapping_contribution(mpiGrid, dimension,-1,popID);
       }
       updateRemoteTimer.stop();
-
    }
+}
 
-   phiprof::Timer btxTimer {"barrier-trans-pre-x", {"Barriers","MPI"}};
-   MPI_Barrier(MPI_COMM_WORLD);
-   btxTimer.stop();
-   
-   // ------------- SLICE - map dist function in X --------------- //
-   if(P::xcells_ini > 1){
-      
-      phiprof::Timer transTimer {"transfer-stencil-data-x", {"MPI"}};
-      //updateRemoteVelocityBlockLists(mpiGrid,popID,VLASOV_SOLVER_X_NEIGHBORHOOD_ID);
-      SpatialCell::set_mpi_transfer_direction(0);
-      SpatialCell::set_mpi_transfer_type(Transfer::VEL_BLOCK_DATA,false,AMRtranslationActive);
-      mpiGrid.update_copies_of_remote_neighbors(VLASOV_SOLVER_X_NEIGHBORHOOD_ID);
-      transTimer.stop();
-      
-      // bt=phiprof::initializeTimer("barrier-trans-pre-trans_map_1d-x","Barriers","MPI");
-      // phiprof::start(bt);
-      // MPI_Barrier(MPI_COMM_WORLD);
-      // phiprof::stop(bt);
+/** Propagates the distribution function of all populations in spatial space. 
+    
+    Based on SLICE-3D algorithm: Zerroukat, M., and T. Allen. "A
+    three‐dimensional monotone and conservative semi‐Lagrangian scheme
+    (SLICE‐3D) for transport problems." Quarterly Journal of the Royal
+    Meteorological Society 138.667 (2012): 1640-1651.
+  
+ */
+void calculateSpatialTranslation(
+        dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+        const vector<CellID>& local_propagated_cells,
+        const vector<CellID>& remoteTargetCellsx,
+        const vector<CellID>& remoteTargetCellsy,
+        const vector<CellID>& remoteTargetCellsz,
+        vector<uint>& nPencils,
+        creal dt,
+        Real &time
+) {
 
-      t1 = MPI_Wtime();
-      phiprof::Timer computeTimer {"compute-mapping-x"};
-      if(P::amrMaxSpatialRefLevel == 0) {
-         trans_map_1d(mpiGrid,local_propagated_cells, remoteTargetCellsx, 0,dt,popID); // map along x//
-      } else {
-         trans_map_1d_amr(mpiGrid,local_propagated_cells, remoteTargetCellsx, nPencils, 0,dt,popID); // map along x//
-      }
-      computeTimer.stop();
-      time += MPI_Wtime() - t1;
+   addTimedBarrier("barrier-trans-pre-z");
 
-      phiprof::Timer btTimer {"barrier-trans-pre-update_remote-x", {"Barriers","MPI"}};
-      MPI_Barrier(MPI_COMM_WORLD);
-      btTimer.stop();
+   // ------------- SLICE - map dist function in Z --------------- //
+   if(P::zcells_ini > 1) {
+      translateDimension(mpiGrid, local_propagated_cells, remoteTargetCellsz, nPencils, 2, dt, time);
+   }
 
-      phiprof::Timer updateRemoteTimer {"update_remote-x", {"MPI"}};
-      if(P::amrMaxSpatialRefLevel == 0) {
-         update_remote_mapping_contribution(mpiGrid, 0,+1,popID);
-         update_remote_mapping_contribution(mpiGrid, 0,-1,popID);
-      } else {
-         update_remote_mapping_contribution_amr(mpiGrid, 0,+1,popID);
-         update_remote_mapping_contribution_amr(mpiGrid, 0,-1,popID);
-      }
-      updateRemoteTimer.stop();
+   addTimedBarrier("barrier-trans-pre-x");
+
+   // ------------- SLICE - map dist function in X --------------- //
+   if(P::xcells_ini > 1) {
+      translateDimension(mpiGrid, local_propagated_cells, remoteTargetCellsx, nPencils, 0, dt, time);
    }
 
-   phiprof::Timer btyTimer {"barrier-trans-pre-y", {"Barriers","MPI"}};
-   MPI_Barrier(MPI_COMM_WORLD);
-   btyTimer.stop();
+   addTimedBarrier("barrier-trans-pre-y");
 
    // ------------- SLICE - map dist function in Y --------------- //
    if(P::ycells_ini > 1) {
-      
-      phiprof::Timer transTimer {"transfer-stencil-data-y", {"MPI"}};
-      //updateRemoteVelocityBlockLists(mpiGrid,popID,VLASOV_SOLVER_Y_NEIGHBORHOOD_ID);
-      SpatialCell::set_mpi_transfer_direction(1);
-      SpatialCell::set_mpi_transfer_type(Transfer::VEL_BLOCK_DATA,false,AMRtranslationActive);
-      mpiGrid.update_copies_of_remote_neighbors(VLASOV_SOLVER_Y_NEIGHBORHOOD_ID);
-      transTimer.stop();
-      
-      // bt=phiprof::initializeTimer("barrier-trans-pre-trans_map_1d-y","Barriers","MPI");
-      // phiprof::start(bt);
-      // MPI_Barrier(MPI_COMM_WORLD);
-      // phiprof::stop(bt);
-
-      t1 = MPI_Wtime();
-      phiprof::Timer computeTimer {"compute-mapping-y"};
-      if(P::amrMaxSpatialRefLevel == 0) {
-         trans_map_1d(mpiGrid,local_propagated_cells, remoteTargetCellsy, 1,dt,popID); // map along y//
-      } else {
-         trans_map_1d_amr(mpiGrid,local_propagated_cells, remoteTargetCellsy, nPencils, 1,dt,popID); // map along y//      
-      }
-      computeTimer.stop();
-      time += MPI_Wtime() - t1;
-      
-      phiprof::Timer btTimer {"barrier-trans-pre-update_remote-y", {"Barriers","MPI"}};
-      MPI_Barrier(MPI_COMM_WORLD);
-      btTimer.stop();
-
-      phiprof::Timer updateRemoteTimer {"update_remote-y", {"MPI"}};
-      if(P::amrMaxSpatialRefLevel == 0) {
-         update_remote_mapping_contribution(mpiGrid, 1,+1,popID);
-         update_remote_mapping_contribution(mpiGrid, 1,-1,popID);
-      } else {
-         update_remote_mapping_contribution_amr(mpiGrid, 1,+1,popID);
-         update_remote_mapping_contribution_amr(mpiGrid, 1,-1,popID);
-      }
-      updateRemoteTimer.stop();
+      translateDimension(mpiGrid, local_propagated_cells, remoteTargetCellsy, nPencils, 1, dt, time);
    }
 
-   phiprof::Timer btpostimer {"barrier-trans-post-trans",{"Barriers","MPI"}};
-   MPI_Barrier(MPI_COMM_WORLD);
-   btpostimer.stop();
+   addTimedBarrier("barrier-trans-post-trans");
 
    // MPI_Barrier(MPI_COMM_WORLD);
    // bailout(true, "", __FILE__, __LINE__);
@@ -250,7 +272,6 @@ void calculateSpatialTranslation(
    vector<CellID> remoteTargetCellsy;
    vector<CellID> remoteTargetCellsz;
    vector<CellID> local_propagated_cells;
-   vector<CellID> local_target_cells;
    vector<uint> nPencils;
    Real time=0.0;
    
@@ -274,13 +295,6 @@ void calculateSpatialTranslation(
       }
    }
    
-   // Figure out target spatial cells, result
-   // independent of particle species.
-   for (size_t c=0; c<localCells.size(); ++c) {
-      if (mpiGrid[localCells[c]]->sysBoundaryFlag == sysboundarytype::NOT_SYSBOUNDARY) {
-         local_target_cells.push_back(localCells[c]);
-      }
-   }
    if (P::prepareForRebalance == true && P::amrMaxSpatialRefLevel != 0) {
       // One more element to count the sums
       for (size_t c=0; c<local_propagated_cells.size()+1; c++) {
@@ -290,25 +304,16 @@ void calculateSpatialTranslation(
    computeTimer.stop();
 
    // Translate all particle species
-   for (uint popID=0; popID<getObjectWrapper().particleSpecies.size(); ++popID) {
-      string profName = "translate "+getObjectWrapper().particleSpecies[popID].name;
-      phiprof::Timer timer {profName};
-      SpatialCell::setCommunicatedSpecies(popID);
-      //      std::cout << "I am at line " << __LINE__ << " of " << __FILE__ << std::endl;
-      calculateSpatialTranslation(
-         mpiGrid,
-         localCells,
-         local_propagated_cells,
-         local_target_cells,
-         remoteTargetCellsx,
-         remoteTargetCellsy,
-         remoteTargetCellsz,
-         nPencils,
-         dt,
-         popID,
-         time
-      );
-   }
+   calculateSpatialTranslation(
+      mpiGrid,
+      local_propagated_cells,
+      remoteTargetCellsx,
+      remoteTargetCellsy,
+      remoteTargetCellsz,
+      nPencils,
+      dt,
+      time
+   );
    
    if (Parameters::prepareForRebalance == true) {
       if(P::amrMaxSpatialRefLevel == 0) {
@@ -342,6 +347,91 @@ void calculateSpatialTranslation(
   --------------------------------------------------
 */
 
+/** Order in which cells are accelerated. The cost of a cell is its number of
+ * velocity blocks, times its number of subcycles if all of them are taken at
+ * once. Cells with at least P::vlasovThreadedAccelerationBlocks blocks come
+ * first, they are accelerated one at a time by all threads. The remaining
+ * cells follow, the most expensive first, so that the dynamic schedule fills
+ * the tail of the loop with the cheap ones.
+ * @param mpiGrid Parallel grid library.
+ * @param cells Cells to be accelerated.
+ * @param popID Particle population ID.
+ * @param dt Timestep.
+ * @param allSubcycles If true, cells take all of their subcycles in one go.
+ * @param nThreadedCells Number of cells at the start of the returned order
+ * which should be accelerated by all threads together.
+ * @return Indices to cells, in order of decreasing cost.*/
+static std::vector<size_t> getAccelerationOrder(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+                                                const std::vector<CellID>& cells,
+                                                const uint popID,
+                                                const Real& dt,
+                                                const bool allSubcycles,
+                                                size_t& nThreadedCells) {
+   std::vector<std::pair<uint64_t,size_t>> costs(cells.size());
+   std::vector<bool> threaded(cells.size(), false);
+   for (size_t c=0; c<cells.size(); ++c) {
+      SpatialCell* cell = mpiGrid[cells[c]];
+      const vmesh::LocalID nBlocks = cell->get_number_of_velocity_blocks(popID);
+      uint64_t cost = nBlocks;
+      if (allSubcycles) {
+         cost *= getAccelerationSubcycles(cell, dt, popID);
+      }
+      costs[c] = std::make_pair(cost, c);
+      threaded[c] = P::vlasovThreadedAccelerationBlocks > 0 && nBlocks >= P::vlasovThreadedAccelerationBlocks;
+   }
+   std::stable_sort(costs.begin(), costs.end(),
+                    [&threaded](const std::pair<uint64_t,size_t>& a, const std::pair<uint64_t,size_t>& b) {
+                       if (threaded[a.second] != threaded[b.second]) {
+                          return bool(threaded[a.second]);
+                       }
+                       return a.first > b.first;
+                    });
+
+   std::vector<size_t> order(cells.size());
+   nThreadedCells = 0;
+   for (size_t c=0; c<cells.size(); ++c) {
+      order[c] = costs[c].second;
+      if (threaded[order[c]]) {
+         nThreadedCells++;
+      }
+   }
+   return order;
+}
+
+/** Accelerate the given population in one cell over one subcycle step of the
+ * lockstep acceleration.
+ * @param cell Spatial cell.
+ * @param popID Particle population ID.
+ * @param step The current subcycle step.
+ * @param dt Timestep.*/
+static void accelerateCellSubcycle(SpatialCell* cell, const uint popID, const uint step, const Real& dt) {
+   const Real maxVdt = cell->get_max_v_dt(popID);
+
+   //compute subcycle dt. The length is maxVdt on all steps
+   //except the last one. This is to keep the neighboring
+   //spatial cells in sync, so that two neighboring cells with
+   //different number of subcycles have similar timesteps,
+   //except that one takes an additional short step. This keeps
+   //spatial block neighbors as much in sync as possible for
+   //adjust blocks.
+   Real subcycleDt;
+   if( (step + 1) * maxVdt > fabs(dt)) {
+      subcycleDt = max(fabs(dt) - step * maxVdt, 0.0);
+   } else{
+      subcycleDt = maxVdt;
+   }
+   if (dt<0) subcycleDt = -subcycleDt;
+
+   //generate pseudo-random order which is always the same irrespective of parallelization, restarts, etc.
+   std::default_random_engine rndState;
+   // set seed, initialise generator and get value. The order is the same
+   // for all cells, but varies with timestep.
+   rndState.seed(P::tstep);
+
+   uint map_order=std::uniform_int_distribution<>(0,2)(rndState);
+   cpu_accelerate_cell(cell,popID,map_order,subcycleDt);
+}
+
 /** Accelerate the given population to new time t+dt.
  * This function is AMR safe.
  * @param popID Particle population ID.
@@ -362,36 +452,24 @@ void calculateAcceleration(const uint popID,const uint globalMaxSubcycles,const
    // Calculated moments are stored in the "_V" variables.
    calculateMoments_V(mpiGrid, propagatedCells, false);
 
-   // Semi-Lagrangian acceleration for those cells which are subcycled
-   #pragma omp parallel for schedule(dynamic,1)
-   for (size_t c=0; c<propagatedCells.size(); ++c) {
-      const CellID cellID = propagatedCells[c];
-      const Real maxVdt = mpiGrid[cellID]->get_max_v_dt(popID);
-      
-      //compute subcycle dt. The length is maxVdt on all steps
-      //except the last one. This is to keep the neighboring
-      //spatial cells in sync, so that two neighboring cells with
-      //different number of subcycles have similar timesteps,
-      //except that one takes an additional short step. This keeps
-      //spatial block neighbors as much in sync as possible for
-      //adjust blocks.
-      Real subcycleDt;
-      if( (step + 1) * maxVdt > fabs(dt)) {
-	 subcycleDt = max(fabs(dt) - step * maxVdt, 0.0);
-      } else{
-         subcycleDt = maxVdt;
-      }
-      if (dt<0) subcycleDt = -subcycleDt;
-      
-      //generate pseudo-random order which is always the same irrespective of parallelization, restarts, etc.
-      std::default_random_engine rndState;
-      // set seed, initialise generator and get value. The order is the same
-      // for all cells, but varies with timestep.
-      rndState.seed(P::tstep);
+   size_t nThreadedCells;
+   const std::vector<size_t> order = getAccelerationOrder(mpiGrid, propagatedCells, popID, dt, false, nThreadedCells);
 
-      uint map_order=std::uniform_int_distribution<>(0,2)(rndState);
+   // Semi-Lagrangian acceleration for those cells which are subcycled.
+   // Very large cells one at a time, the mapping is threaded within the cell.
+   phiprof::Timer threadedAccTimer {"threaded-cell-semilag-acc"};
+   for (size_t c=0; c<nThreadedCells; ++c) {
+      accelerateCellSubcycle(mpiGrid[propagatedCells[order[c]]], popID, step, dt);
+   }
+   threadedAccTimer.stop();
+
+   #pragma omp parallel
+   {
       phiprof::Timer semilagAccTimer {"cell-semilag-acc"};
-      cpu_accelerate_cell(mpiGrid[cellID],popID,map_order,subcycleDt);
+      #pragma omp for schedule(dynamic,1) nowait
+      for (size_t c=nThreadedCells; c<order.size(); ++c) {
+         accelerateCellSubcycle(mpiGrid[propagatedCells[order[c]]], popID, step, dt);
+      }
       semilagAccTimer.stop();
    }
 
@@ -406,6 +484,99 @@ void calculateAcceleration(const uint popID,const uint globalMaxSubcycles,const
    if(step < (globalMaxSubcycles - 1)) adjustVelocityBlocks(mpiGrid, propagatedCells, false, popID);
 }
 
+/** Accelerate the given population in one cell over all of its subcycles,
+ * see calculateLocalAcceleration.
+ * @param cell Spatial cell.
+ * @param popID Particle population ID.
+ * @param map_order Order in which vx,vy,vz mappings are performed.
+ * @param dt Timestep.*/
+static void accelerateCellAllSubcycles(SpatialCell* cell, const uint popID, const uint map_order, const Real& dt) {
+   const Real maxVdt = cell->get_max_v_dt(popID);
+   const uint subcycles = getAccelerationSubcycles(cell, dt, popID);
+
+   for (uint step=0; step<subcycles; ++step) {
+      if (step > 0 && !P::vlasovOnTheFlyMoments) {
+         calculateCellMoments_V(cell);
+      }
+
+      // Subcycle dt as in the lockstep version: maxVdt on all steps except the last one
+      Real subcycleDt;
+      if( (step + 1) * maxVdt > fabs(dt)) {
+         subcycleDt = max(fabs(dt) - step * maxVdt, 0.0);
+      } else {
+         subcycleDt = maxVdt;
+      }
+      if (dt<0) subcycleDt = -subcycleDt;
+
+      // Moments for the next subcycle are accumulated by the last mapping
+      Real momentSums[4] = {0.0, 0.0, 0.0, 0.0};
+      const bool accumulateMoments = P::vlasovOnTheFlyMoments && step < subcycles - 1;
+
+      cpu_accelerate_cell(cell,popID,map_order,subcycleDt,accumulateMoments ? momentSums : NULL);
+
+      // Local adjust keeps the distribution from streaming out of the
+      // existing blocks. Nothing is deleted, since spatial neighbour
+      // content is not known here. Thus the accumulated moments are
+      // still valid afterwards.
+      if (step < subcycles - 1) {
+         cell->updateSparseMinValue(popID);
+         cell->adjustSingleCellVelocityBlocks(popID, false);
+      }
+      if (accumulateMoments) {
+         storeCellMoments_V(cell, popID, momentSums);
+      }
+   }
+}
+
+/** Accelerate the given population to new time t+dt, subcycling each cell
+ * independently of the others. Each cell takes all of its own subcycles in one
+ * go, so cells with few subcycles do not wait for the globally slowest cell.
+ * In between subcycles the velocity mesh is only adjusted locally, i.e. blocks
+ * are added around the cell's own content but not removed. Removal and the
+ * neighbour-aware adjustment are left to the adjustVelocityBlocks call that
+ * follows this function. With P::vlasovOnTheFlyMoments the _V moments of the
+ * next subcycle are accumulated by the last mapping of the previous one.
+ * This function is AMR safe.
+ * @param popID Particle population ID.
+ * @param mpiGrid Parallel grid library.
+ * @param propagatedCells List of cells in which the population is accelerated.
+ * @param dt Timestep.*/
+void calculateLocalAcceleration(const uint popID,
+                                dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>& mpiGrid,
+                                const std::vector<CellID>& propagatedCells,
+                                const Real& dt) {
+   // Set active population
+   SpatialCell::setCommunicatedSpecies(popID);
+
+   // Moments of the first subcycle, later ones are recomputed per cell
+   calculateMoments_V(mpiGrid, propagatedCells, false);
+
+   // Same pseudo-random dimension order as in the lockstep version
+   std::default_random_engine rndState;
+   rndState.seed(P::tstep);
+   const uint map_order=std::uniform_int_distribution<>(0,2)(rndState);
+
+   size_t nThreadedCells;
+   const std::vector<size_t> order = getAccelerationOrder(mpiGrid, propagatedCells, popID, dt, true, nThreadedCells);
+
+   // Very large cells one at a time, the mapping is threaded within the cell
+   phiprof::Timer threadedAccTimer {"threaded-cell-semilag-acc"};
+   for (size_t c=0; c<nThreadedCells; ++c) {
+      accelerateCellAllSubcycles(mpiGrid[propagatedCells[order[c]]], popID, map_order, dt);
+   }
+   threadedAccTimer.stop();
+
+   #pragma omp parallel
+   {
+      phiprof::Timer semilagAccTimer {"cell-semilag-acc"};
+      #pragma omp for schedule(dynamic,1) nowait
+      for (size_t c=nThreadedCells; c<order.size(); ++c) {
+         accelerateCellAllSubcycles(mpiGrid[propagatedCells[order[c]]], popID, map_order, dt);
+      }
+      semilagAccTimer.stop();
+   }
+}
+
 /** Accelerate all particle populations to new time t+dt. 
  * This function is AMR safe.
  * @param mpiGrid Parallel grid library.
@@ -465,6 +636,15 @@ void calculateAcceleration(dccrg::Dccrg<SpatialCell,dccrg::Cartesian_Geometry>&
             }
          }
 
+         if (P::vlasovLocalAccelerationSubcycles) {
+            // Each cell subcycles on its own, no global lockstep needed
+            calculateLocalAcceleration(popID, mpiGrid, propagatedCells, dt);
+
+            // final adjust for all cells, also fixing remote cells.
+            adjustVelocityBlocks(mpiGrid, cells, true, popID);
+            continue;
+         }
+
          // Compute global maximum for number of subcycles
          MPI_Allreduce(&maxSubcycles, &globalMaxSubcycles, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
          